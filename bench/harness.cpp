@@ -4,74 +4,362 @@
 // Copyright 2016 whitequark
 //-----------------------------------------------------------------------------
 #include "solvespace.h"
+#if defined(WIN32)
+#   include <windows.h>
+#   include <psapi.h>
+#else
+#   include <sys/resource.h>
+#endif
 
-static bool RunBenchmark(std::function<void()> setupFn,
+struct BenchmarkOptions {
+    size_t warmupIter = 1;
+    size_t minIter    = 5;
+    double minTime    = 5.0;
+    bool   json       = false;
+};
+
+// The most memory that the process has had resident at any one time, or zero
+// if we can't tell.
+static uint64_t GetPeakMemory() {
+#if defined(WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#   if defined(__APPLE__)
+    return (uint64_t)usage.ru_maxrss;
+#   else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#   endif
+#endif
+}
+
+// The time below which the given fraction of the (sorted) times fall.
+static double Percentile(const std::vector<double> &times, double fraction) {
+    size_t rank = (size_t)ceil(fraction * (double)times.size());
+    if(rank > 0) rank--;
+    return times[std::min(rank, times.size() - 1)];
+}
+
+static bool RunBenchmark(const std::string &mode, const Platform::Path &filename,
+                         const BenchmarkOptions &options,
+                         std::function<void()> setupFn,
                          std::function<bool()> benchFn,
-                         std::function<void()> teardownFn,
-                         size_t minIter = 5, double minTime = 5.0) {
+                         std::function<void()> teardownFn) {
     // Warmup
-    setupFn();
-    if(!benchFn()) {
-        fprintf(stderr, "Benchmark failed\n");
-        return false;
+    for(size_t i = 0; i < options.warmupIter; i++) {
+        setupFn();
+        if(!benchFn()) {
+            fprintf(stderr, "Benchmark failed\n");
+            return false;
+        }
+        teardownFn();
     }
-    teardownFn();
 
     // Benchmark
-    size_t iter = 0;
+    std::vector<double> times;
     double time = 0.0;
-    while(iter < minIter || time < minTime) {
+    uint64_t startAllocations, startBytes;
+    Platform::GetTemporaryCounters(&startAllocations, &startBytes);
+    while(times.size() < options.minIter || time < options.minTime) {
         setupFn();
         auto testStartTime = std::chrono::steady_clock::now();
-        benchFn();
+        bool ok = benchFn();
         auto testEndTime = std::chrono::steady_clock::now();
         teardownFn();
+        if(!ok) {
+            fprintf(stderr, "Benchmark failed\n");
+            return false;
+        }
 
         std::chrono::duration<double> testTime = testEndTime - testStartTime;
+        times.push_back(testTime.count());
         time += testTime.count();
-        iter += 1;
     }
+    uint64_t endAllocations, endBytes;
+    Platform::GetTemporaryCounters(&endAllocations, &endBytes);
+    std::sort(times.begin(), times.end());
 
     // Report
-    fprintf(stdout, "Iterations: %zd\n", iter);
-    fprintf(stdout, "Time:       %.3f s\n", time);
-    fprintf(stdout, "Per iter.:  %.3f s\n", time / (double)iter);
+    size_t iter = times.size();
+    uint64_t tempBytes = (endBytes - startBytes) / iter;
+    if(options.json) {
+        fprintf(stdout, "{\"mode\":%s,\"source\":%s,\"iterations\":%zu,\"time\":%.6f,"
+                        "\"mean\":%.6f,\"min\":%.6f,\"p50\":%.6f,\"p90\":%.6f,\"p99\":%.6f,"
+                        "\"max\":%.6f,\"temp_bytes_per_iter\":%llu,\"peak_memory\":%llu}\n",
+                SolveSpace::JsonString(mode).c_str(),
+                SolveSpace::JsonString(filename.raw).c_str(), iter, time,
+                time / (double)iter, times.front(), Percentile(times, 0.5),
+                Percentile(times, 0.9), Percentile(times, 0.99), times.back(),
+                (unsigned long long)tempBytes, (unsigned long long)GetPeakMemory());
+        fflush(stdout);
+    } else {
+        fprintf(stdout, "Mode:       %s\n", mode.c_str());
+        fprintf(stdout, "Iterations: %zd\n", iter);
+        fprintf(stdout, "Time:       %.3f s\n", time);
+        fprintf(stdout, "Per iter.:  %.3f s\n", time / (double)iter);
+        fprintf(stdout, "Min:        %.3f s\n", times.front());
+        fprintf(stdout, "Median:     %.3f s\n", Percentile(times, 0.5));
+        fprintf(stdout, "90th pct.:  %.3f s\n", Percentile(times, 0.9));
+        fprintf(stdout, "99th pct.:  %.3f s\n", Percentile(times, 0.99));
+        fprintf(stdout, "Max:        %.3f s\n", times.back());
+        fprintf(stdout, "Temporary:  %.1f MiB per iter.\n", tempBytes / 1048576.0);
+        fprintf(stdout, "Peak mem.:  %.1f MiB\n", GetPeakMemory() / 1048576.0);
+    }
 
     return true;
 }
 
+static bool LoadModel(const Platform::Path &filename) {
+    SS.Init();
+    if(!SS.LoadFromFile(filename)) {
+        fprintf(stderr, "Cannot load '%s'!\n", filename.raw.c_str());
+        return false;
+    }
+    SS.AfterNewFile();
+    return true;
+}
+
+static void UnloadModel() {
+    SK.Clear();
+    SS.Clear();
+}
+
+// A point that the user could drag in the active group, or failing that, the
+// last one in any group; or NULL if there are none.
+static Entity *FindDraggablePoint() {
+    Entity *found = NULL;
+    for(Entity &e : SK.entity) {
+        if(e.type != Entity::Type::POINT_IN_2D && e.type != Entity::Type::POINT_IN_3D) continue;
+        if(!e.h.isFromRequest()) continue;
+        if(found != NULL && found->group == SS.GW.activeGroup &&
+           e.group != SS.GW.activeGroup) continue;
+        found = &e;
+    }
+    return found;
+}
+
+// Combine the shell of every group with the shell before it, as regenerating
+// the model would; the results are discarded.
+static void CombineAllShells() {
+    for(hGroup hg : SK.groupOrder) {
+        Group *g = SK.GetGroup(hg);
+        if(g->IsForcedToMesh() || g->suppress || g->thisShell.IsEmpty()) continue;
+
+        // A step and repeat gets merged against the group's previous group,
+        // not our own previous group.
+        Group *srcg = g;
+        if(g->type == Group::Type::TRANSLATE || g->type == Group::Type::ROTATE) {
+            srcg = SK.GetGroup(g->opA);
+        }
+        SShell *prevs = &srcg->RunningMeshGroup()->runningShell;
+
+        SShell result = {};
+        switch(srcg->meshCombine) {
+            case Group::CombineAs::UNION:
+                result.MakeFromUnionOf(prevs, &g->thisShell);
+                break;
+            case Group::CombineAs::DIFFERENCE:
+                result.MakeFromDifferenceOf(prevs, &g->thisShell);
+                break;
+            case Group::CombineAs::INTERSECTION:
+                result.MakeFromIntersectionOf(prevs, &g->thisShell);
+                break;
+            case Group::CombineAs::ASSEMBLE:
+                result.MakeFromAssemblyOf(prevs, &g->thisShell);
+                break;
+        }
+        result.Clear();
+    }
+}
+
+static void ShowUsage(const std::string &cmd) {
+    fprintf(stderr, "Usage: %s [options] <mode> <filename>\n", cmd.c_str());
+    fprintf(stderr, R"(
+Modes:
+    load          Load the file and regenerate it.
+    generate      Regenerate every group of the loaded file.
+    drag          Solve the active group again and again, as if one of its
+                  points were being dragged.
+    boolean       Combine the shell of every group with the one before it.
+    triangulate   Triangulate the shell of the active group.
+    hidden-line   Export an isometric view with hidden lines removed, as SVG.
+    export-stl    Export the mesh as STL.
+    export-step   Export the surfaces as STEP.
+    all           All of the above, one after another.
+
+Options:
+    --warmup <n>        Discard the first <n> iterations (default 1).
+    --min-iter <n>      Run at least <n> iterations (default 5).
+    --min-time <s>      Run for at least <s> seconds (default 5).
+    --output <path>     Where to write exported files; they're removed
+                        afterwards (default: "benchmark" in the current
+                        directory, with the extension of the format).
+    --json              Report each mode as one line of JSON.
+)");
+}
+
 int main(int argc, char **argv) {
     std::vector<std::string> args = Platform::InitCli(argc, argv);
 
-    std::string mode;
-    Platform::Path filename;
-    if(args.size() == 3) {
-        mode = args[1];
-        filename = Platform::Path::From(args[2]);
-    } else {
-        fprintf(stderr, "Usage: %s [mode] [filename]\n", args[0].c_str());
-        fprintf(stderr, "Mode can be one of: load.\n");
+    BenchmarkOptions options;
+    std::vector<std::string> positional;
+    Platform::Path output = Platform::Path::From("benchmark");
+    for(size_t argn = 1; argn < args.size(); argn++) {
+        const std::string &arg = args[argn];
+        bool hasValue = (argn + 1 < args.size());
+        if(arg == "--json") {
+            options.json = true;
+        } else if(arg == "--warmup" && hasValue) {
+            options.warmupIter = (size_t)std::stoul(args[++argn]);
+        } else if(arg == "--min-iter" && hasValue) {
+            options.minIter = std::max((size_t)1, (size_t)std::stoul(args[++argn]));
+        } else if(arg == "--min-time" && hasValue) {
+            options.minTime = std::stod(args[++argn]);
+        } else if(arg == "--output" && hasValue) {
+            output = Platform::Path::From(args[++argn]);
+        } else if(arg.size() > 1 && arg[0] == '-') {
+            fprintf(stderr, "Unrecognized option '%s'.\n", arg.c_str());
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if(positional.size() != 2) {
+        ShowUsage(args[0]);
         return 1;
     }
 
-    bool result = false;
-    if(mode == "load") {
-        result = RunBenchmark(
-            [] {
-                SS.Init();
-            },
-            [&] {
-                if(!SS.LoadFromFile(filename))
-                    return false;
-                SS.AfterNewFile();
-                return true;
-            },
-            [] {
-                SK.Clear();
-                SS.Clear();
-            });
+    std::string mode = positional[0];
+    Platform::Path filename = Platform::Path::From(positional[1]);
+
+    static const char *const modes[] = {
+        "load", "generate", "drag", "boolean", "triangulate",
+        "hidden-line", "export-stl", "export-step",
+    };
+    std::vector<std::string> toRun;
+    if(mode == "all") {
+        toRun.assign(std::begin(modes), std::end(modes));
+    } else if(std::find(std::begin(modes), std::end(modes), mode) != std::end(modes)) {
+        toRun.push_back(mode);
     } else {
         fprintf(stderr, "Unknown mode \"%s\"\n", mode.c_str());
+        return 1;
+    }
+
+    bool result = true;
+    for(const std::string &m : toRun) {
+        auto nothing = [] {};
+
+        if(m == "load") {
+            result = RunBenchmark(m, filename, options,
+                [] {
+                    SS.Init();
+                },
+                [&] {
+                    if(!SS.LoadFromFile(filename))
+                        return false;
+                    SS.AfterNewFile();
+                    return true;
+                },
+                UnloadModel);
+            if(!result) break;
+            continue;
+        }
+
+        // The rest work on a model that's already loaded.
+        if(!LoadModel(filename)) {
+            result = false;
+            break;
+        }
+
+        if(m == "generate") {
+            result = RunBenchmark(m, filename, options, nothing,
+                [] {
+                    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+                    return true;
+                },
+                nothing);
+        } else if(m == "drag") {
+            Entity *pt = FindDraggablePoint();
+            if(pt == NULL) {
+                fprintf(stderr, "No point to drag in '%s'\n", filename.raw.c_str());
+                result = false;
+            } else {
+                hEntity hp = pt->h;
+                hGroup hg = pt->group;
+                SS.GW.pending.point = hp;
+                // Move the point back and forth around where it started, by a
+                // little less each time, as a mouse might.
+                int step = 0;
+                result = RunBenchmark(m, filename, options,
+                    [&] {
+                        Entity *e = SK.GetEntity(hp);
+                        int count = (e->type == Entity::Type::POINT_IN_2D) ? 2 : 3;
+                        double delta = ((step % 2 == 0) ? 1.0 : -1.0) / (1 + step % 16);
+                        for(int i = 0; i < count; i++) {
+                            SK.GetParam(e->param[i])->val += delta;
+                        }
+                        step++;
+                    },
+                    [&] {
+                        SS.SolveGroup(hg, /*andFindFree=*/false);
+                        return true;
+                    },
+                    nothing);
+                SS.GW.pending.point = {};
+            }
+        } else if(m == "boolean") {
+            result = RunBenchmark(m, filename, options, nothing,
+                [] {
+                    CombineAllShells();
+                    return true;
+                },
+                nothing);
+        } else if(m == "triangulate") {
+            SShell *shell = &SK.GetGroup(SS.GW.activeGroup)->runningShell;
+            result = RunBenchmark(m, filename, options, nothing,
+                [&] {
+                    SMesh mesh = {};
+                    shell->TriangulateInto(&mesh);
+                    mesh.Clear();
+                    return true;
+                },
+                nothing);
+        } else {
+            Platform::Path outputFile;
+            std::function<void()> exportFn;
+            if(m == "hidden-line") {
+                outputFile = output.WithExtension("svg");
+                SS.GW.projRight = Vector::From(0.707,  0.000, -0.707);
+                SS.GW.projUp    = Vector::From(-0.408, 0.816, -0.408);
+                exportFn = [&] { SS.ExportViewOrWireframeTo(outputFile, /*exportWireframe=*/false); };
+            } else if(m == "export-stl") {
+                outputFile = output.WithExtension("stl");
+                exportFn = [&] { SS.ExportMeshTo(outputFile); };
+            } else if(m == "export-step") {
+                outputFile = output.WithExtension("step");
+                exportFn = [&] {
+                    StepFileWriter sfw = {};
+                    sfw.ExportSurfacesTo(outputFile);
+                };
+            } else {
+                ssassert(false, "Unexpected benchmark mode");
+            }
+
+            result = RunBenchmark(m, filename, options, nothing,
+                [&] {
+                    exportFn();
+                    return true;
+                },
+                nothing);
+            RemoveFile(outputFile);
+        }
+
+        UnloadModel();
+        if(!result) break;
     }
 
     return (result == true ? 0 : 1);
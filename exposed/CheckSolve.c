@@ -0,0 +1,217 @@
+/*-----------------------------------------------------------------------------
+ * Checks for the ways that slvs.dll can solve a system besides Slvs_Solve():
+ * in a context of our own, again from the equations of the solve before, and
+ * in a batch of scenarios. Each should give the same answer as Slvs_Solve()
+ * does on its own. Returns nonzero if any of them doesn't.
+ *---------------------------------------------------------------------------*/
+#ifdef WIN32
+#   include <windows.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <slvs.h>
+
+#define MAX_PARAMS      20
+#define SCENARIOS       40
+
+static Slvs_Param       param[MAX_PARAMS];
+static Slvs_Entity      entity[20];
+static Slvs_Constraint  constraint[20];
+static Slvs_hConstraint failed[20];
+
+static int failures;
+
+static void Check(int ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "okay" : "FAILED", what);
+    if(!ok) failures++;
+}
+
+/*-----------------------------------------------------------------------------
+ * A workplane along the xy plane, with its origin at (x0 y0), in group 1; and
+ * in group 2, a line segment and a circle within that workplane. The line is
+ * fully constrained, and the circle is free. The initial guesses for group 2
+ * are offset by guess.
+ *---------------------------------------------------------------------------*/
+static void MakeSystem(Slvs_System *sys, double x0, double y0, double guess)
+{
+    Slvs_hGroup g;
+    double qw, qx, qy, qz;
+
+    memset(sys, 0, sizeof(*sys));
+    sys->param      = param;
+    sys->entity     = entity;
+    sys->constraint = constraint;
+    sys->failed     = failed;
+    sys->faileds    = 20;
+    sys->calculateFaileds = 1;
+
+    g = 1;
+    sys->param[sys->params++] = Slvs_MakeParam(1, g, x0);
+    sys->param[sys->params++] = Slvs_MakeParam(2, g, y0);
+    sys->param[sys->params++] = Slvs_MakeParam(3, g, 0.0);
+    sys->entity[sys->entities++] = Slvs_MakePoint3d(101, g, 1, 2, 3);
+    Slvs_MakeQuaternion(1, 0, 0,
+                        0, 1, 0, &qw, &qx, &qy, &qz);
+    sys->param[sys->params++] = Slvs_MakeParam(4, g, qw);
+    sys->param[sys->params++] = Slvs_MakeParam(5, g, qx);
+    sys->param[sys->params++] = Slvs_MakeParam(6, g, qy);
+    sys->param[sys->params++] = Slvs_MakeParam(7, g, qz);
+    sys->entity[sys->entities++] = Slvs_MakeNormal3d(102, g, 4, 5, 6, 7);
+    sys->entity[sys->entities++] = Slvs_MakeWorkplane(200, g, 101, 102);
+
+    g = 2;
+    sys->param[sys->params++] = Slvs_MakeParam(11, g, 10.0 + guess);
+    sys->param[sys->params++] = Slvs_MakeParam(12, g, 20.0 - guess);
+    sys->entity[sys->entities++] = Slvs_MakePoint2d(301, g, 200, 11, 12);
+    sys->param[sys->params++] = Slvs_MakeParam(13, g, 20.0 - guess);
+    sys->param[sys->params++] = Slvs_MakeParam(14, g, 10.0 + guess);
+    sys->entity[sys->entities++] = Slvs_MakePoint2d(302, g, 200, 13, 14);
+    sys->entity[sys->entities++] = Slvs_MakeLineSegment(400, g,
+                                        200, 301, 302);
+
+    sys->param[sys->params++] = Slvs_MakeParam(15, g, 100.0 + guess);
+    sys->param[sys->params++] = Slvs_MakeParam(16, g, 120.0);
+    sys->entity[sys->entities++] = Slvs_MakePoint2d(303, g, 200, 15, 16);
+    sys->param[sys->params++] = Slvs_MakeParam(17, g, 30.0);
+    sys->entity[sys->entities++] = Slvs_MakeDistance(304, g, 200, 17);
+    sys->entity[sys->entities++] = Slvs_MakeCircle(401, g, 200,
+                                    303, 102, 304);
+
+    sys->constraint[sys->constraints++] = Slvs_MakeConstraint(
+                                            1, g,
+                                            SLVS_C_PT_PT_DISTANCE,
+                                            200,
+                                            30.0,
+                                            301, 302, 0, 0);
+    sys->constraint[sys->constraints++] = Slvs_MakeConstraint(
+                                            2, g,
+                                            SLVS_C_PT_LINE_DISTANCE,
+                                            200,
+                                            10.0,
+                                            101, 0, 400, 0);
+    sys->constraint[sys->constraints++] = Slvs_MakeConstraint(
+                                            3, g,
+                                            SLVS_C_VERTICAL,
+                                            200,
+                                            0.0,
+                                            0, 0, 400, 0);
+    sys->constraint[sys->constraints++] = Slvs_MakeConstraint(
+                                            4, g,
+                                            SLVS_C_PT_PT_DISTANCE,
+                                            200,
+                                            15.0,
+                                            301, 101, 0, 0);
+}
+
+/* Whether two solves of the same system put its params in the same place. */
+static int SameSolution(int params, const double *a, const double *b)
+{
+    int i;
+    for(i = 0; i < params; i++) {
+        if(fabs(a[i] - b[i]) > 1e-9) return 0;
+    }
+    return 1;
+}
+
+static void SaveVals(const Slvs_System *sys, double *val)
+{
+    int i;
+    for(i = 0; i < sys->params; i++) {
+        val[i] = sys->param[i].val;
+    }
+}
+
+int main()
+{
+    Slvs_System sys;
+    Slvs_SolveStats stats;
+    Slvs_Context *ctx;
+    double expected[MAX_PARAMS], val[MAX_PARAMS];
+    int expectedResult, expectedDof;
+    int i;
+
+    /* Slvs_Solve() first, to have something to compare with. */
+    MakeSystem(&sys, 0.0, 0.0, 0.0);
+    Slvs_Solve(&sys, 2);
+    Check(sys.result == SLVS_RESULT_OKAY && sys.dof == 3,
+          "Slvs_Solve");
+    SaveVals(&sys, expected);
+    expectedResult = sys.result;
+    expectedDof = sys.dof;
+
+    /* The same system in a context of our own. */
+    ctx = Slvs_CreateContext();
+    MakeSystem(&sys, 0.0, 0.0, 0.0);
+    Slvs_SolveInContext(ctx, &sys, 2);
+    SaveVals(&sys, val);
+    Slvs_GetSolveStats(ctx, &stats);
+    Check(sys.result == expectedResult && sys.dof == expectedDof &&
+          SameSolution(sys.params, val, expected) && !stats.reused,
+          "Slvs_SolveInContext matches Slvs_Solve");
+
+    /* Then again, from the same initial guesses; only the values of the
+     * params have changed since, so its equations are reused. */
+    MakeSystem(&sys, 0.0, 0.0, 0.0);
+    Slvs_SolveInContext(ctx, &sys, 2);
+    SaveVals(&sys, val);
+    Slvs_GetSolveStats(ctx, &stats);
+    Check(stats.reused == 1, "solving the same system again reuses it");
+    Check(sys.result == expectedResult && sys.dof == expectedDof &&
+          SameSolution(sys.params, val, expected),
+          "solving again matches Slvs_Solve");
+
+    /* A constraint more, so the equations must be written afresh. */
+    MakeSystem(&sys, 0.0, 0.0, 0.0);
+    sys.constraint[sys.constraints++] = Slvs_MakeConstraint(
+                                            5, 2,
+                                            SLVS_C_DIAMETER,
+                                            200,
+                                            40.0,
+                                            0, 0, 401, 0);
+    Slvs_SolveInContext(ctx, &sys, 2);
+    SaveVals(&sys, val);
+    Slvs_GetSolveStats(ctx, &stats);
+    Check(stats.reused == 0, "a changed system is solved from scratch");
+    Check(sys.result == SLVS_RESULT_OKAY && sys.dof == 2 &&
+          fabs(val[13] - 20.0) < 1e-9,
+          "a changed system is solved for its new constraint");
+    Slvs_DestroyContext(ctx);
+
+    /* And a batch of scenarios, which move the workplane and start from
+     * different guesses; each must match a solve on its own. */
+    {
+        static double vals[SCENARIOS*MAX_PARAMS];
+        int results[SCENARIOS], dofs[SCENARIOS];
+        int params, allSame = 1;
+
+        MakeSystem(&sys, 0.0, 0.0, 0.0);
+        params = sys.params;
+        for(i = 0; i < SCENARIOS; i++) {
+            MakeSystem(&sys, i * 5.0, -i * 2.0, (i % 7) * 0.5);
+            SaveVals(&sys, &vals[i*params]);
+        }
+        MakeSystem(&sys, 0.0, 0.0, 0.0);
+        Slvs_SolveBatch(&sys, 2, SCENARIOS, vals, results, dofs);
+
+        for(i = 0; i < SCENARIOS; i++) {
+            Slvs_System one;
+            MakeSystem(&one, i * 5.0, -i * 2.0, (i % 7) * 0.5);
+            Slvs_Solve(&one, 2);
+            SaveVals(&one, val);
+
+            if(results[i] != one.result || dofs[i] != one.dof ||
+               !SameSolution(params, &vals[i*params], val))
+            {
+                allSame = 0;
+            }
+        }
+        Check(allSame, "Slvs_SolveBatch matches Slvs_Solve per scenario");
+    }
+
+    return failures ? 1 : 0;
+}
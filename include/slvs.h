@@ -198,6 +198,56 @@ typedef struct {
 
 DLL void Slvs_Solve(Slvs_System *sys, Slvs_hGroup hg);
 
+/* A context holds everything that the solver needs while it works. Solving
+ * in different contexts at the same time, from different threads, is safe;
+ * but a context must not be used by two threads at once. Slvs_Solve() above
+ * uses a context private to the calling thread.
+ *
+ * A context remembers the last system that it solved okay. If the next one
+ * has the same params, entities, constraints, dragged params and group, and
+ * differs only in the values of its params, then it's solved again without
+ * writing its equations or its Jacobian from scratch. */
+typedef struct Slvs_Context Slvs_Context;
+
+DLL Slvs_Context *Slvs_CreateContext(void);
+DLL void Slvs_SolveInContext(Slvs_Context *ctx, Slvs_System *sys, Slvs_hGroup hg);
+DLL void Slvs_DestroyContext(Slvs_Context *ctx);
+
+/* What the last solve in a context did. The equations and unknowns are those
+ * left after substitution; alone is the number of equations that were solved
+ * one at a time before the rest, and iterations counts the Newton steps for
+ * all of them. The residual is the norm of the equations of the last system
+ * to be iterated. Times are in milliseconds. reused is nonzero if the system
+ * was solved again from the equations and Jacobian of the solve before. */
+typedef struct {
+    int                 equations;
+    int                 unknowns;
+    int                 substituted;
+    int                 alone;
+    int                 iterations;
+    double              residual;
+
+    double              substitutionTime;
+    double              jacobianTime;
+    double              rankTestTime;
+    double              linearSolveTime;
+
+    int                 reused;
+} Slvs_SolveStats;
+
+/* A NULL ctx means the context that Slvs_Solve() uses for this thread. */
+DLL void Slvs_GetSolveStats(Slvs_Context *ctx, Slvs_SolveStats *stats);
+
+/* Solves the system once for each of a number of scenarios, which differ only
+ * in the values of the params. The vals array holds sys->params values for
+ * each scenario, in the same order as sys->param; it is overwritten with the
+ * solved values. The result and the degrees of freedom of each scenario are
+ * written to results and dofs, if those aren't NULL. The param values, result
+ * and failed constraints in sys itself are left alone. The scenarios are
+ * shared out between as many threads as there are cores. */
+DLL void Slvs_SolveBatch(Slvs_System *sys, Slvs_hGroup hg, int scenarios,
+                         double *vals, int *results, int *dofs);
+
 
 /* Our base coordinate system has basis vectors
  *     (1, 0, 0)  (0, 1, 0)  (0, 0, 1)
@@ -135,6 +135,14 @@ void TextWindow::ScreenChangeAutomaticLineConstraints(int link, uint32_t v) {
     SS.GW.Invalidate();
 }
 
+void TextWindow::ScreenChangeCacheLinkedFiles(int link, uint32_t v) {
+    SS.cacheLinkedFiles = !SS.cacheLinkedFiles;
+}
+
+void TextWindow::ScreenChangeCompressSavedFiles(int link, uint32_t v) {
+    SS.compressSavedFiles = !SS.compressSavedFiles;
+}
+
 void TextWindow::ScreenChangeShadedTriangles(int link, uint32_t v) {
     SS.exportShadedTriangles = !SS.exportShadedTriangles;
     SS.GW.Invalidate();
@@ -145,6 +153,10 @@ void TextWindow::ScreenChangePwlCurves(int link, uint32_t v) {
     SS.GW.Invalidate();
 }
 
+void TextWindow::ScreenChangeGltfQuantize(int link, uint32_t v) {
+    SS.exportGltfQuantize = !SS.exportGltfQuantize;
+}
+
 void TextWindow::ScreenChangeCanvasSizeAuto(int link, uint32_t v) {
     if(link == 't') {
         SS.exportCanvasSizeAuto = true;
@@ -312,6 +324,9 @@ void TextWindow::ShowConfiguration() {
     Printf(false, "  %Fd%f%Ll%s  export background color%E",
         &ScreenChangeExportBackgroundColor,
         SS.exportBackgroundColor ? CHECK_TRUE : CHECK_FALSE);
+    Printf(false, "  %Fd%f%Ll%s  quantize glTF meshes%E",
+        &ScreenChangeGltfQuantize,
+        SS.exportGltfQuantize ? CHECK_TRUE : CHECK_FALSE);
 
     Printf(false, "");
     Printf(false, "%Ft export canvas size:  "
@@ -373,6 +388,12 @@ void TextWindow::ShowConfiguration() {
     Printf(false, "  %Fd%f%Ll%s  edit newly added dimensions%E",
         &ScreenChangeImmediatelyEditDimension,
         SS.immediatelyEditDimension ? CHECK_TRUE : CHECK_FALSE);
+    Printf(false, "  %Fd%f%Ll%s  cache geometry of linked sketches%E",
+        &ScreenChangeCacheLinkedFiles,
+        SS.cacheLinkedFiles ? CHECK_TRUE : CHECK_FALSE);
+    Printf(false, "  %Fd%f%Ll%s  compress saved sketches%E",
+        &ScreenChangeCompressSavedFiles,
+        SS.compressSavedFiles ? CHECK_TRUE : CHECK_FALSE);
     Printf(false, "");
     Printf(false, "%Ft autosave interval (in minutes)%E");
     Printf(false, "%Ba   %d %Fl%Ll%f[change]%E",
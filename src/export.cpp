@@ -184,6 +184,22 @@ public:
     }
 };
 
+//-----------------------------------------------------------------------------
+// Regenerate the sketch at the export chord tolerance. If it's already been
+// generated for export at the same tolerance, then only what's changed since
+// is regenerated, so that exporting a sketch again and again is cheap.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::GenerateForExport() {
+    bool same = exportMode &&
+                EXACT(exportGeneratedChordTol == ExportChordTolMm()) &&
+                exportGeneratedMaxSegments == exportMaxSegments;
+
+    exportMode = true;
+    GenerateAll(same ? Generate::DIRTY : Generate::ALL);
+    exportGeneratedChordTol    = ExportChordTolMm();
+    exportGeneratedMaxSegments = exportMaxSegments;
+}
+
 void SolveSpaceUI::ExportViewOrWireframeTo(const Platform::Path &filename, bool exportWireframe) {
     SEdgeList edges = {};
     SBezierList beziers = {};
@@ -191,8 +207,7 @@ void SolveSpaceUI::ExportViewOrWireframeTo(const Platform::Path &filename, bool
     VectorFileWriter *out = VectorFileWriter::ForFile(filename);
     if(!out) return;
 
-    SS.exportMode = true;
-    GenerateAll(Generate::ALL);
+    GenerateForExport();
 
     SMesh *sm = NULL;
     if(SS.GW.showShaded || SS.GW.drawOccludedAs != GraphicsWindow::DrawOccludedAs::VISIBLE) {
@@ -314,6 +329,8 @@ void SolveSpaceUI::ExportLinesAndMesh(SEdgeList *sel, SBezierList *sbl, SMesh *s
                                       Vector origin, double cameraTan,
                                       VectorFileWriter *out)
 {
+    Platform::TemporaryScope scope("ExportLinesAndMesh");
+
     double s = 1.0 / SS.exportScale;
 
     // Project into the export plane; so when we're done, z doesn't matter,
@@ -803,12 +820,78 @@ void VectorFileWriter::BezierAsNonrationalCubic(SBezier *sb, int depth) {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Meshes can have millions of triangles, so they are formatted a chunk of
+// triangles at a time, with the chunks of each round done in parallel, and
+// then written out in order; the output is the same as if each triangle had
+// been written by itself. Numbers are formatted by AppendFixed(), which gives
+// exactly what printf() would.
+//-----------------------------------------------------------------------------
+template<class FormatFn>
+static void WriteInChunks(FILE *f, size_t count, FormatFn format) {
+    const size_t CHUNK_ITEMS = 4096, ROUND_CHUNKS = 64;
+
+    std::vector<std::string> chunks(ROUND_CHUNKS);
+    for(size_t first = 0; first < count; first += CHUNK_ITEMS * ROUND_CHUNKS) {
+        size_t roundChunks = std::min(ROUND_CHUNKS,
+                                      (count - first + CHUNK_ITEMS - 1) / CHUNK_ITEMS);
+        ParallelFor(roundChunks, [&](size_t i) {
+            size_t begin = first + i * CHUNK_ITEMS,
+                   end   = std::min(count, begin + CHUNK_ITEMS);
+            std::string *out = &chunks[i];
+            out->clear();
+            for(size_t j = begin; j < end; j++) {
+                format(out, j);
+            }
+        });
+        for(size_t i = 0; i < roundChunks; i++) {
+            fwrite(chunks[i].data(), 1, chunks[i].size(), f);
+        }
+    }
+}
+
+static void AppendInt(std::string *out, int64_t v) {
+    char buf[24];
+    char *p = buf + sizeof(buf);
+    uint64_t u = (v < 0) ? 0u - (uint64_t)v : (uint64_t)v;
+    do {
+        *--p = (char)('0' + u % 10);
+        u /= 10;
+    } while(u != 0);
+    if(v < 0) *--p = '-';
+    out->append(p, buf + sizeof(buf) - p);
+}
+
+static void AppendHex(std::string *out, uint32_t v) {
+    static const char digits[] = "0123456789abcdef";
+    char buf[8];
+    char *p = buf + sizeof(buf);
+    do {
+        *--p = digits[v & 0xf];
+        v >>= 4;
+    } while(v != 0);
+    out->append(p, buf + sizeof(buf) - p);
+}
+
+// A point in the units of the exported file.
+static Vector ExportUnits(Vector v) {
+    return Vector::From(v.x / SS.exportScale, v.y / SS.exportScale, v.z / SS.exportScale);
+}
+
+// The three coordinates, as "%.<digits>f" each, with the separator between.
+static void AppendVector(std::string *out, Vector v, int digits, const char *separator) {
+    AppendFixed(out, v.x, digits);
+    out->append(separator);
+    AppendFixed(out, v.y, digits);
+    out->append(separator);
+    AppendFixed(out, v.z, digits);
+}
+
 //-----------------------------------------------------------------------------
 // Export a triangle mesh, in the requested format.
 //-----------------------------------------------------------------------------
 void SolveSpaceUI::ExportMeshTo(const Platform::Path &filename) {
-    SS.exportMode = true;
-    GenerateAll(Generate::ALL);
+    GenerateForExport();
 
     Group *g = SK.GetGroup(SS.GW.activeGroup);
     g->GenerateDisplayItems();
@@ -845,9 +928,11 @@ void SolveSpaceUI::ExportMeshTo(const Platform::Path &filename) {
         ExportMeshAsThreeJsTo(f, filename, m, e);
     } else if(filename.HasExtension("wrl")) {
         ExportMeshAsVrmlTo(f, filename, m);
+    } else if(filename.HasExtension("glb")) {
+        ExportMeshAsGltfTo(f, m);
     } else {
         Error("Can't identify output file type from file extension of "
-              "filename '%s'; try .stl, .obj, .js, .html.", filename.raw.c_str());
+              "filename '%s'; try .stl, .obj, .glb, .js, .html.", filename.raw.c_str());
     }
 
     fclose(f);
@@ -870,26 +955,18 @@ void SolveSpaceUI::ExportMeshAsStlTo(FILE *f, SMesh *sm) {
     fwrite(&n, 4, 1, f);
 
     double s = SS.exportScale;
-    int i;
-    for(i = 0; i < sm->l.n; i++) {
-        STriangle *tr = &(sm->l[i]);
+    WriteInChunks(f, sm->l.n, [&](std::string *out, size_t i) {
+        const STriangle *tr = &(sm->l[i]);
         Vector n = tr->Normal().WithMagnitude(1);
-        float w;
-        w = (float)n.x;           fwrite(&w, 4, 1, f);
-        w = (float)n.y;           fwrite(&w, 4, 1, f);
-        w = (float)n.z;           fwrite(&w, 4, 1, f);
-        w = (float)((tr->a.x)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->a.y)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->a.z)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->b.x)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->b.y)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->b.z)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->c.x)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->c.y)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->c.z)/s); fwrite(&w, 4, 1, f);
-        fputc(0, f);
-        fputc(0, f);
-    }
+        float w[12] = {
+            (float)n.x,           (float)n.y,           (float)n.z,
+            (float)((tr->a.x)/s), (float)((tr->a.y)/s), (float)((tr->a.z)/s),
+            (float)((tr->b.x)/s), (float)((tr->b.y)/s), (float)((tr->b.z)/s),
+            (float)((tr->c.x)/s), (float)((tr->c.y)/s), (float)((tr->c.z)/s),
+        };
+        out->append((const char *)w, sizeof(w));
+        out->append(2, '\0');
+    });
 }
 
 //-----------------------------------------------------------------------------
@@ -907,12 +984,17 @@ void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
                                       color.blue);
             colors.emplace(color, id);
         }
-        for(int i = 0; i < 3; i++) {
-            fprintf(fObj, "v %.10f %.10f %.10f\n",
-                    CO(t.vertices[i].ScaledBy(1 / SS.exportScale)));
-        }
     }
 
+    WriteInChunks(fObj, sm->l.n, [&](std::string *out, size_t i) {
+        const STriangle &t = sm->l[i];
+        for(int j = 0; j < 3; j++) {
+            out->append("v ");
+            AppendVector(out, t.vertices[j].ScaledBy(1 / SS.exportScale), 10, " ");
+            out->append("\n");
+        }
+    });
+
     for(auto &it : colors) {
         fprintf(fMtl, "newmtl %s\n",
                 it.second.c_str());
@@ -920,27 +1002,35 @@ void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
                 it.first.redF(), it.first.greenF(), it.first.blueF());
     }
 
-    for(const STriangle &t : sm->l) {
-        for(int i = 0; i < 3; i++) {
-            Vector n = t.normals[i].WithMagnitude(1.0);
-            fprintf(fObj, "vn %.10f %.10f %.10f\n",
-                    CO(n));
+    WriteInChunks(fObj, sm->l.n, [&](std::string *out, size_t i) {
+        const STriangle &t = sm->l[i];
+        for(int j = 0; j < 3; j++) {
+            Vector n = t.normals[j].WithMagnitude(1.0);
+            out->append("vn ");
+            AppendVector(out, n, 10, " ");
+            out->append("\n");
         }
-    }
+    });
 
-    RgbaColor currentColor = {};
-    for(int i = 0; i < sm->l.n; i++) {
+    WriteInChunks(fObj, sm->l.n, [&](std::string *out, size_t i) {
         const STriangle &t = sm->l[i];
-        if(!currentColor.Equals(t.meta.color)) {
-            currentColor = t.meta.color;
-            fprintf(fObj, "usemtl %s\n", colors[currentColor].c_str());
+        RgbaColor previousColor = (i > 0) ? sm->l[i - 1].meta.color : RgbaColor {};
+        if(!previousColor.Equals(t.meta.color)) {
+            out->append("usemtl ");
+            out->append(colors.at(t.meta.color));
+            out->append("\n");
         }
 
-        fprintf(fObj, "f %d//%d %d//%d %d//%d\n",
-                i * 3 + 1, i * 3 + 1,
-                i * 3 + 2, i * 3 + 2,
-                i * 3 + 3, i * 3 + 3);
-    }
+        out->append("f");
+        for(int j = 0; j < 3; j++) {
+            int64_t vertex = (int64_t)i * 3 + j + 1;
+            out->append(" ");
+            AppendInt(out, vertex);
+            out->append("//");
+            AppendInt(out, vertex);
+        }
+        out->append("\n");
+    });
 }
 
 //-----------------------------------------------------------------------------
@@ -949,8 +1039,7 @@ void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
 void SolveSpaceUI::ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename,
                                          SMesh *sm, SOutlineList *sol)
 {
-    SPointList spl = {};
-    STriangle *tr;
+    SPointIndex points;
     Vector bndl, bndh;
 
     const std::string THREE_FN("three-r111.min.js");
@@ -1053,62 +1142,71 @@ void SolveSpaceUI::ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename
     fprintf(f, "    ],\n"
                "    a: %f\n", SS.ambientIntensity);
 
-    for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        spl.IncrementTagFor(tr->a);
-        spl.IncrementTagFor(tr->b);
-        spl.IncrementTagFor(tr->c);
+    std::vector<int> vertexIndex(sm->l.n * 3);
+    for(int i = 0; i < sm->l.n; i++) {
+        for(int j = 0; j < 3; j++) {
+            vertexIndex[i * 3 + j] = points.IndexFor(sm->l[i].vertices[j]);
+        }
     }
 
     // Output all the vertices.
-    SPoint *sp;
     fputs("  },\n"
           "  points: [\n", f);
-    for(sp = spl.l.First(); sp; sp = spl.l.NextAfter(sp)) {
-        fprintf(f, "    [%f, %f, %f],\n",
-                sp->p.x / SS.exportScale,
-                sp->p.y / SS.exportScale,
-                sp->p.z / SS.exportScale);
-    }
+    WriteInChunks(f, points.points.size(), [&](std::string *out, size_t i) {
+        out->append("    [");
+        AppendVector(out, ExportUnits(points.points[i]), 6, ", ");
+        out->append("],\n");
+    });
 
     fputs("  ],\n"
           "  faces: [\n", f);
     // And now all the triangular faces, in terms of those vertices.
     // This time we count from zero.
-    for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        fprintf(f, "    [%d, %d, %d],\n",
-                spl.IndexForPoint(tr->a),
-                spl.IndexForPoint(tr->b),
-                spl.IndexForPoint(tr->c));
-    }
+    WriteInChunks(f, sm->l.n, [&](std::string *out, size_t i) {
+        out->append("    [");
+        AppendInt(out, vertexIndex[i * 3 + 0]);
+        out->append(", ");
+        AppendInt(out, vertexIndex[i * 3 + 1]);
+        out->append(", ");
+        AppendInt(out, vertexIndex[i * 3 + 2]);
+        out->append("],\n");
+    });
 
     // Output face normals.
     fputs("  ],\n"
           "  normals: [\n", f);
-    for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        fprintf(f, "    [[%f, %f, %f], [%f, %f, %f], [%f, %f, %f]],\n",
-                CO(tr->an), CO(tr->bn), CO(tr->cn));
-    }
+    WriteInChunks(f, sm->l.n, [&](std::string *out, size_t i) {
+        const STriangle &tr = sm->l[i];
+        out->append("    [[");
+        AppendVector(out, tr.an, 6, ", ");
+        out->append("], [");
+        AppendVector(out, tr.bn, 6, ", ");
+        out->append("], [");
+        AppendVector(out, tr.cn, 6, ", ");
+        out->append("]],\n");
+    });
 
     fputs("  ],\n"
           "  colors: [\n", f);
     // Output triangle colors.
-    for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        fprintf(f, "    0x%x,\n", tr->meta.color.ToARGB32());
-    }
+    WriteInChunks(f, sm->l.n, [&](std::string *out, size_t i) {
+        out->append("    0x");
+        AppendHex(out, sm->l[i].meta.color.ToARGB32());
+        out->append(",\n");
+    });
 
     fputs("  ],\n"
           "  edges: [\n", f);
     // Output edges. Assume user's model colors do not obscure white edges.
-    for(const SOutline &so : sol->l) {
-        if(so.tag == 0) continue;
-        fprintf(f, "    [[%f, %f, %f], [%f, %f, %f]],\n",
-                so.a.x / SS.exportScale,
-                so.a.y / SS.exportScale,
-                so.a.z / SS.exportScale,
-                so.b.x / SS.exportScale,
-                so.b.y / SS.exportScale,
-                so.b.z / SS.exportScale);
-    }
+    WriteInChunks(f, sol->l.n, [&](std::string *out, size_t i) {
+        const SOutline &so = sol->l[i];
+        if(so.tag == 0) return;
+        out->append("    [[");
+        AppendVector(out, ExportUnits(so.a), 6, ", ");
+        out->append("], [");
+        AppendVector(out, ExportUnits(so.b), 6, ", ");
+        out->append("]],\n");
+    });
 
     fputs("  ]\n};\n", f);
 
@@ -1120,8 +1218,6 @@ void SolveSpaceUI::ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename
                 CO(SS.GW.projUp),
                 CO(SS.GW.projRight));
     }
-
-    spl.Clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -1185,78 +1281,328 @@ void SolveSpaceUI::ExportMeshAsVrmlTo(FILE *f, const Platform::Path &filename, S
                 SS.ambientIntensity,
                 1.f - ((float)op.first / 255.0f));
 
-        SPointList spl = {};
-
+        std::vector<const STriangle *> triangles;
         for(const auto & sp : op.second) {
             for(const auto & tr : sp) {
-                spl.IncrementTagFor(tr.a);
-                spl.IncrementTagFor(tr.b);
-                spl.IncrementTagFor(tr.c);
+                triangles.push_back(&tr);
             }
         }
 
-        // Output all the vertices.
-        for(auto sp : spl.l) {
-            fprintf(f, "          %f %f %f,\n",
-                    sp.p.x / SS.exportScale,
-                    sp.p.y / SS.exportScale,
-                    sp.p.z / SS.exportScale);
+        SPointIndex points;
+        std::vector<int> vertexIndex(triangles.size() * 3);
+        for(size_t i = 0; i < triangles.size(); i++) {
+            for(int j = 0; j < 3; j++) {
+                vertexIndex[i * 3 + j] = points.IndexFor(triangles[i]->vertices[j]);
+            }
         }
 
+        // Output all the vertices.
+        WriteInChunks(f, points.points.size(), [&](std::string *out, size_t i) {
+            out->append("          ");
+            AppendVector(out, ExportUnits(points.points[i]), 6, " ");
+            out->append(",\n");
+        });
+
         fputs("        ] }\n"
               "        coordIndex [\n", f);
         // And now all the triangular faces, in terms of those vertices.
-        for(const auto & sp : op.second) {
-            for(const auto & tr : sp) {
-                fprintf(f, "          %d, %d, %d, -1,\n",
-                        spl.IndexForPoint(tr.a),
-                        spl.IndexForPoint(tr.b),
-                        spl.IndexForPoint(tr.c));
+        WriteInChunks(f, triangles.size(), [&](std::string *out, size_t i) {
+            for(int j = 0; j < 3; j++) {
+                out->append(j == 0 ? "          " : ", ");
+                AppendInt(out, vertexIndex[i * 3 + j]);
             }
-        }
+            out->append(", -1,\n");
+        });
 
         fputs("        ]\n"
               "        color Color { color [\n", f);
         // Output triangle colors.
         std::vector<int> triangle_colour_ids;
         std::vector<RgbaColor> colours_present;
-        for(const auto & sp : op.second) {
-            for(const auto & tr : sp) {
-                const auto colour_itr = std::find_if(colours_present.begin(), colours_present.end(),
-                                                     [&](const RgbaColor & c) {
-                                                         return c.Equals(tr.meta.color);
-                                                     });
-                if(colour_itr == colours_present.end()) {
-                    fprintf(f, "          %.10f %.10f %.10f,\n",
-                            tr.meta.color.redF(),
-                            tr.meta.color.greenF(),
-                            tr.meta.color.blueF());
-                    triangle_colour_ids.push_back(colours_present.size());
-                    colours_present.insert(colours_present.end(), tr.meta.color);
-                } else {
-                    triangle_colour_ids.push_back(colour_itr - colours_present.begin());
-                }
+        for(const STriangle *tr : triangles) {
+            const auto colour_itr = std::find_if(colours_present.begin(), colours_present.end(),
+                                                 [&](const RgbaColor & c) {
+                                                     return c.Equals(tr->meta.color);
+                                                 });
+            if(colour_itr == colours_present.end()) {
+                fprintf(f, "          %.10f %.10f %.10f,\n",
+                        tr->meta.color.redF(),
+                        tr->meta.color.greenF(),
+                        tr->meta.color.blueF());
+                triangle_colour_ids.push_back(colours_present.size());
+                colours_present.insert(colours_present.end(), tr->meta.color);
+            } else {
+                triangle_colour_ids.push_back(colour_itr - colours_present.begin());
             }
         }
 
         fputs("        ] }\n"
               "        colorIndex [\n", f);
 
-        for(auto colour_idx : triangle_colour_ids) {
-            fprintf(f, "          %d, %d, %d, -1,\n", colour_idx, colour_idx, colour_idx);
-        }
+        WriteInChunks(f, triangle_colour_ids.size(), [&](std::string *out, size_t i) {
+            for(int j = 0; j < 3; j++) {
+                out->append(j == 0 ? "          " : ", ");
+                AppendInt(out, triangle_colour_ids[i]);
+            }
+            out->append(", -1,\n");
+        });
 
         fputs("        ]\n"
               "      }\n"
               "    }\n", f);
-
-        spl.Clear();
     }
 
     fputs("  ]\n"
           "}\n", f);
 }
 
+//-----------------------------------------------------------------------------
+// Export the mesh as binary glTF 2.0 (.glb). The vertices are shared by all
+// the triangles, with the points that are Equals() merged and a vertex for
+// each distinct normal at a point; then there is a primitive with its own
+// indices and material for each color. If asked to, the positions and normals
+// are quantized as in KHR_mesh_quantization: positions into 16 bit integers
+// that the node's transform scales back, and normals into 8 bits.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::ExportMeshAsGltfTo(FILE *f, SMesh *sm) {
+    struct VertexKey {
+        int      point;
+        float    normal[3];
+
+        bool operator==(const VertexKey &other) const {
+            return point == other.point && normal[0] == other.normal[0] &&
+                   normal[1] == other.normal[1] && normal[2] == other.normal[2];
+        }
+    };
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey &key) const {
+            size_t h = (size_t)key.point;
+            for(float c : key.normal) {
+                // So that -0 and 0, which are equal, hash the same.
+                h = h * 31 + std::hash<float>()(c == 0.0f ? 0.0f : c);
+            }
+            return h;
+        }
+    };
+    struct Primitive {
+        RgbaColor             color;
+        std::vector<uint32_t> indices;
+    };
+
+    SPointIndex points;
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexIndex;
+    std::vector<Vector> positions;
+    std::vector<Vector> normals;
+    std::vector<Primitive> primitives;
+    std::map<RgbaColor, size_t, RgbaColorCompare> primitiveForColor;
+    for(const STriangle &tr : sm->l) {
+        auto it = primitiveForColor.find(tr.meta.color);
+        if(it == primitiveForColor.end()) {
+            it = primitiveForColor.emplace(tr.meta.color, primitives.size()).first;
+            primitives.push_back({ tr.meta.color, {} });
+        }
+        Primitive *prim = &primitives[it->second];
+
+        for(int i = 0; i < 3; i++) {
+            Vector n = tr.normals[i];
+            if(n.Magnitude() < LENGTH_EPS) n = tr.Normal();
+            n = (n.Magnitude() < LENGTH_EPS) ? Vector::From(0, 0, 1) : n.WithMagnitude(1);
+
+            VertexKey key = {};
+            key.point     = points.IndexFor(tr.vertices[i]);
+            key.normal[0] = (float)n.x;
+            key.normal[1] = (float)n.y;
+            key.normal[2] = (float)n.z;
+            auto vertex = vertexIndex.emplace(key, (uint32_t)positions.size());
+            if(vertex.second) {
+                positions.push_back(ExportUnits(points.points[key.point]));
+                normals.push_back(n);
+            }
+            prim->indices.push_back(vertex.first->second);
+        }
+    }
+
+    Vector pmax = positions[0], pmin = positions[0];
+    for(const Vector &p : positions) {
+        p.MakeMaxMin(&pmax, &pmin);
+    }
+
+    // Lay out the binary chunk: the positions, the normals, and then the
+    // indices of each primitive, each of them aligned to four bytes.
+    std::string bin;
+    auto align = [&]() { bin.resize((bin.size() + 3) & ~(size_t)3, '\0'); };
+    auto appendRaw = [&](const void *data, size_t size) {
+        bin.append((const char *)data, size);
+    };
+
+    bool   quantize = SS.exportGltfQuantize;
+    double quantScale = 1.0;
+    if(quantize) {
+        Vector extent = pmax.Minus(pmin);
+        quantScale = max(extent.x, max(extent.y, extent.z)) / 65535.0;
+        if(quantScale <= 0) quantScale = 1.0;
+    }
+
+    // The bounds of the accessor have to be exactly those of what is stored.
+    uint16_t qmax[3] = {};
+    size_t positionsOffset = bin.size();
+    for(const Vector &p : positions) {
+        if(quantize) {
+            uint16_t q[4] = {};
+            for(int i = 0; i < 3; i++) {
+                double v = (p.Element(i) - pmin.Element(i)) / quantScale;
+                q[i] = (uint16_t)max(0.0, min(65535.0, floor(v + 0.5)));
+                qmax[i] = max(qmax[i], q[i]);
+            }
+            appendRaw(q, sizeof(q));
+        } else {
+            float v[3] = { (float)p.x, (float)p.y, (float)p.z };
+            appendRaw(v, sizeof(v));
+        }
+    }
+    size_t positionsLength = bin.size() - positionsOffset;
+
+    size_t normalsOffset = bin.size();
+    for(const Vector &n : normals) {
+        if(quantize) {
+            int8_t q[4] = {};
+            for(int i = 0; i < 3; i++) {
+                q[i] = (int8_t)floor(n.Element(i) * 127.0 + 0.5);
+            }
+            appendRaw(q, sizeof(q));
+        } else {
+            float v[3] = { (float)n.x, (float)n.y, (float)n.z };
+            appendRaw(v, sizeof(v));
+        }
+    }
+    size_t normalsLength = bin.size() - normalsOffset;
+
+    bool wideIndices = positions.size() > 65535;
+    std::vector<size_t> indicesOffset, indicesLength;
+    for(const Primitive &prim : primitives) {
+        indicesOffset.push_back(bin.size());
+        for(uint32_t index : prim.indices) {
+            if(wideIndices) {
+                appendRaw(&index, sizeof(index));
+            } else {
+                uint16_t index16 = (uint16_t)index;
+                appendRaw(&index16, sizeof(index16));
+            }
+        }
+        indicesLength.push_back(bin.size() - indicesOffset.back());
+        align();
+    }
+
+    // And describe all of that in the JSON chunk.
+    const int ARRAY_BUFFER = 34962, ELEMENT_ARRAY_BUFFER = 34963;
+    const int BYTE = 5120, UNSIGNED_SHORT = 5123, UNSIGNED_INT = 5125, FLOAT = 5126;
+
+    auto vec3 = [](Vector v) {
+        return ssprintf("[%.9g,%.9g,%.9g]", v.x, v.y, v.z);
+    };
+    // sRGB to the linear values that glTF wants.
+    auto linear = [](float c) {
+        return (c <= 0.04045f) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+    };
+
+    std::string json;
+    json += ssprintf("{\"asset\":{\"version\":\"2.0\",\"generator\":\"SolveSpace %s\"},",
+                     PACKAGE_VERSION);
+    if(quantize) {
+        json += "\"extensionsUsed\":[\"KHR_mesh_quantization\"],"
+                "\"extensionsRequired\":[\"KHR_mesh_quantization\"],";
+    }
+    json += "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],";
+    json += "\"nodes\":[{\"mesh\":0";
+    if(quantize) {
+        json += ",\"translation\":" + vec3(pmin);
+        json += ",\"scale\":" + vec3(Vector::From(quantScale, quantScale, quantScale));
+    }
+    json += "}],";
+
+    json += "\"meshes\":[{\"primitives\":[";
+    for(size_t i = 0; i < primitives.size(); i++) {
+        if(i > 0) json += ",";
+        json += ssprintf("{\"attributes\":{\"POSITION\":0,\"NORMAL\":1},"
+                         "\"indices\":%d,\"material\":%d}", (int)i + 2, (int)i);
+    }
+    json += "]}],";
+
+    json += "\"materials\":[";
+    for(size_t i = 0; i < primitives.size(); i++) {
+        RgbaColor color = primitives[i].color;
+        if(i > 0) json += ",";
+        json += ssprintf("{\"name\":\"h%02x%02x%02x\","
+                         "\"pbrMetallicRoughness\":{\"baseColorFactor\":[%.6f,%.6f,%.6f,%.6f],"
+                         "\"metallicFactor\":0,\"roughnessFactor\":0.5}",
+                         color.red, color.green, color.blue,
+                         linear(color.redF()), linear(color.greenF()), linear(color.blueF()),
+                         color.alphaF());
+        if(color.alpha != 255) json += ",\"alphaMode\":\"BLEND\"";
+        json += "}";
+    }
+    json += "],";
+
+    json += ssprintf("\"buffers\":[{\"byteLength\":%llu}],", (unsigned long long)bin.size());
+    json += "\"bufferViews\":[";
+    json += ssprintf("{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,"
+                     "\"byteStride\":%d,\"target\":%d},",
+                     (unsigned long long)positionsOffset, (unsigned long long)positionsLength,
+                     quantize ? 8 : 12, ARRAY_BUFFER);
+    json += ssprintf("{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,"
+                     "\"byteStride\":%d,\"target\":%d}",
+                     (unsigned long long)normalsOffset, (unsigned long long)normalsLength,
+                     quantize ? 4 : 12, ARRAY_BUFFER);
+    for(size_t i = 0; i < primitives.size(); i++) {
+        json += ssprintf(",{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,\"target\":%d}",
+                         (unsigned long long)indicesOffset[i], (unsigned long long)indicesLength[i],
+                         ELEMENT_ARRAY_BUFFER);
+    }
+    json += "],";
+
+    json += "\"accessors\":[";
+    if(quantize) {
+        json += ssprintf("{\"bufferView\":0,\"componentType\":%d,\"count\":%llu,\"type\":\"VEC3\","
+                         "\"min\":[0,0,0],\"max\":[%d,%d,%d]},",
+                         UNSIGNED_SHORT, (unsigned long long)positions.size(),
+                         qmax[0], qmax[1], qmax[2]);
+        json += ssprintf("{\"bufferView\":1,\"componentType\":%d,\"normalized\":true,"
+                         "\"count\":%llu,\"type\":\"VEC3\"}",
+                         BYTE, (unsigned long long)normals.size());
+    } else {
+        Vector fmax = Vector::From((float)pmax.x, (float)pmax.y, (float)pmax.z),
+               fmin = Vector::From((float)pmin.x, (float)pmin.y, (float)pmin.z);
+        json += ssprintf("{\"bufferView\":0,\"componentType\":%d,\"count\":%llu,\"type\":\"VEC3\","
+                         "\"min\":%s,\"max\":%s},",
+                         FLOAT, (unsigned long long)positions.size(),
+                         vec3(fmin).c_str(), vec3(fmax).c_str());
+        json += ssprintf("{\"bufferView\":1,\"componentType\":%d,\"count\":%llu,\"type\":\"VEC3\"}",
+                         FLOAT, (unsigned long long)normals.size());
+    }
+    for(size_t i = 0; i < primitives.size(); i++) {
+        json += ssprintf(",{\"bufferView\":%d,\"componentType\":%d,\"count\":%llu,"
+                         "\"type\":\"SCALAR\"}",
+                         (int)i + 2, wideIndices ? UNSIGNED_INT : UNSIGNED_SHORT,
+                         (unsigned long long)primitives[i].indices.size());
+    }
+    json += "]}";
+    json.resize((json.size() + 3) & ~(size_t)3, ' ');
+
+    // The container: a header, and then the JSON and binary chunks.
+    uint32_t header[3] = {
+        0x46546C67, // "glTF"
+        2,
+        (uint32_t)(12 + 8 + json.size() + 8 + bin.size()),
+    };
+    uint32_t jsonChunk[2] = { (uint32_t)json.size(), 0x4E4F534A }, // "JSON"
+             binChunk[2]  = { (uint32_t)bin.size(),  0x004E4942 }; // "BIN"
+    fwrite(header, sizeof(header), 1, f);
+    fwrite(jsonChunk, sizeof(jsonChunk), 1, f);
+    fwrite(json.data(), 1, json.size(), f);
+    fwrite(binChunk, sizeof(binChunk), 1, f);
+    fwrite(bin.data(), 1, bin.size(), f);
+}
+
 //-----------------------------------------------------------------------------
 // Export a view of the model as an image; we just take a screenshot, by
 // rendering the view in the usual way and then copying the pixels.
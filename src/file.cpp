@@ -4,13 +4,10 @@
 // Copyright 2008-2013 Jonathan Westhues.
 //-----------------------------------------------------------------------------
 #include "solvespace.h"
+#include <zlib.h>
 
 #define VERSION_STRING "\261\262\263" "SolveSpaceREVa"
 
-static int StrStartsWith(const char *str, const char *start) {
-    return memcmp(str, start, strlen(start)) == 0;
-}
-
 //-----------------------------------------------------------------------------
 // Clear and free all the dynamic memory associated with our currently-loaded
 // sketch. This does not leave the program in an acceptable state (with the
@@ -34,6 +31,7 @@ void SolveSpaceUI::ClearExisting() {
     SK.entity.Clear();
     SK.param.Clear();
     images.clear();
+    ClearGroupGeometry();
 }
 
 hGroup SolveSpaceUI::CreateDefaultDrawingGroup() {
@@ -220,13 +218,235 @@ struct SAVEDptr {
     uint32_t  &x() { return *((uint32_t *)this); }
 };
 
-void SolveSpaceUI::SaveUsingTable(const Platform::Path &filename, int type) {
+// SAVED[] points into SS.sv; this finds the same field in another SaveData,
+// so that we can read more than one file at once.
+static SAVEDptr *SavedField(const SolveSpaceUI::SaveTable *st, SolveSpaceUI::SaveData *data) {
+    ptrdiff_t offset = (const char *)st->ptr - (const char *)&SS.sv;
+    return (SAVEDptr *)((char *)data + offset);
+}
+
+// Where the object of the given type is within SS.sv.
+static const void *SavedBase(int type) {
+    switch(type) {
+        case 'g': return &SS.sv.g;
+        case 'r': return &SS.sv.r;
+        case 'e': return &SS.sv.e;
+        case 'p': return &SS.sv.p;
+        case 'c': return &SS.sv.c;
+        case 's': return &SS.sv.s;
+        default: ssassert(false, "Unexpected object type");
+    }
+}
+
+// Whether two objects of the given type would be saved identically; a and b
+// point to a Group for type 'g', a Request for 'r', and so on.
+bool SolveSpaceUI::SavedFieldsEqual(int type, const void *a, const void *b) {
+    const void *base = SavedBase(type);
+    for(int i = 0; SAVED[i].type != 0; i++) {
+        if(SAVED[i].type != type) continue;
+
+        ptrdiff_t offset = (const char *)SAVED[i].ptr - (const char *)base;
+        SAVEDptr *pa = (SAVEDptr *)((char *)a + offset),
+                 *pb = (SAVEDptr *)((char *)b + offset);
+        bool same = true;
+        switch(SAVED[i].fmt) {
+            case 'S': same = (pa->S() == pb->S());              break;
+            case 'P': same = (pa->P().raw == pb->P().raw);      break;
+            case 'b': same = (pa->b() == pb->b());              break;
+            case 'c': same = pa->c().Equals(pb->c());           break;
+            case 'd': same = (pa->d() == pb->d());              break;
+            case 'f': same = EXACT(pa->f() == pb->f());         break;
+            case 'x': same = (pa->x() == pb->x());              break;
+
+            case 'M': {
+                const EntityMap &ma = pa->M(), &mb = pb->M();
+                same = (ma.size() == mb.size());
+                for(auto it = ma.begin(); same && it != ma.end(); ++it) {
+                    auto jt = mb.find(it->first);
+                    same = (jt != mb.end() && jt->second.v == it->second.v);
+                }
+                break;
+            }
+
+            case 'i': break;
+
+            default: ssassert(false, "Unexpected value format");
+        }
+        if(!same) return false;
+    }
+    return true;
+}
+
+// Mix everything about an object that would be saved into the hash h; objects
+// that are SavedFieldsEqual() hash the same.
+uint64_t SolveSpaceUI::HashSavedFields(int type, const void *obj, uint64_t h) {
+    auto mix = [&](uint64_t v) {
+        h = (h ^ v) * 0x100000001b3ull;
+        h ^= h >> 29;
+    };
+
+    const void *base = SavedBase(type);
+    for(int i = 0; SAVED[i].type != 0; i++) {
+        if(SAVED[i].type != type) continue;
+
+        ptrdiff_t offset = (const char *)SAVED[i].ptr - (const char *)base;
+        SAVEDptr *p = (SAVEDptr *)((char *)obj + offset);
+        switch(SAVED[i].fmt) {
+            case 'S': mix(std::hash<std::string>()(p->S()));        break;
+            case 'P': mix(std::hash<std::string>()(p->P().raw));    break;
+            case 'b': mix(p->b() ? 1 : 0);                          break;
+            case 'c': mix(p->c().ToPackedInt());                    break;
+            case 'd': mix((uint32_t)p->d());                        break;
+            case 'x': mix(p->x());                                  break;
+
+            case 'f': {
+                uint64_t bits;
+                double f = p->f();
+                memcpy(&bits, &f, sizeof(bits));
+                mix(bits);
+                break;
+            }
+
+            case 'M': {
+                // The map is unordered, so combine its entries the same
+                // way whatever order we visit them in.
+                uint64_t sum = 0;
+                for(const auto &it : p->M()) {
+                    uint64_t e = ((uint64_t)it.first.input.v << 32) ^
+                                 ((uint64_t)(uint32_t)it.first.copyNumber << 16) ^
+                                 it.second.v;
+                    sum += (e ^ (e >> 31)) * 0x9e3779b97f4a7c15ull;
+                }
+                mix(sum);
+                break;
+            }
+
+            case 'i': break;
+
+            default: ssassert(false, "Unexpected value format");
+        }
+    }
+    return h;
+}
+
+//-----------------------------------------------------------------------------
+// A writer for our file format, which builds up the whole file in memory so
+// that it can be written out (and maybe compressed) in one go. Numbers are
+// formatted by hand, which is much faster than printf(), but gives exactly
+// what "%d", "%08x" and "%.20f" would.
+//-----------------------------------------------------------------------------
+class SolveSpace::SlvsWriter {
+public:
+    std::string data;
+
+    SlvsWriter() { data.reserve(1 << 20); }
+
+    SlvsWriter &Str(const char *str)        { data.append(str); return *this; }
+    SlvsWriter &Str(const std::string &str) { data.append(str); return *this; }
+    SlvsWriter &Char(char c)                { data.push_back(c); return *this; }
+
+    SlvsWriter &Int(int v) {
+        char buf[16];
+        char *p = buf + sizeof(buf);
+        uint32_t u = (v < 0) ? 0u - (uint32_t)v : (uint32_t)v;
+        do {
+            *--p = (char)('0' + u % 10);
+            u /= 10;
+        } while(u != 0);
+        if(v < 0) *--p = '-';
+        data.append(p, buf + sizeof(buf) - p);
+        return *this;
+    }
+
+    SlvsWriter &Hex(uint32_t v) {
+        static const char digits[] = "0123456789abcdef";
+        char buf[8];
+        for(int i = 7; i >= 0; i--) {
+            buf[i] = digits[v & 0xf];
+            v >>= 4;
+        }
+        data.append(buf, sizeof(buf));
+        return *this;
+    }
+
+    SlvsWriter &Double(double v) {
+        AppendFixed(&data, v, 20);
+        return *this;
+    }
+
+    SlvsWriter &Vec(Vector v) {
+        return Double(v.x).Char(' ').Double(v.y).Char(' ').Double(v.z);
+    }
+};
+
+//-----------------------------------------------------------------------------
+// Our files may be stored gzip-compressed; we write that if the user asks for
+// it, and recognize it by its magic number when reading.
+//-----------------------------------------------------------------------------
+static bool IsGzipData(const char *data, size_t size) {
+    return size >= 2 && (uint8_t)data[0] == 0x1f && (uint8_t)data[1] == 0x8b;
+}
+
+static bool GzipData(const std::string &input, std::string *output) {
+    z_stream zs = {};
+    // A window of 15 bits, plus 16 to ask for a gzip header and trailer.
+    if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                    Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    output->resize(deflateBound(&zs, (uLong)input.size()));
+    zs.next_in   = (Bytef *)input.data();
+    zs.avail_in  = (uInt)input.size();
+    zs.next_out  = (Bytef *)&(*output)[0];
+    zs.avail_out = (uInt)output->size();
+    int result = deflate(&zs, Z_FINISH);
+    output->resize(zs.total_out);
+    deflateEnd(&zs);
+    return result == Z_STREAM_END;
+}
+
+static bool GunzipData(const char *data, size_t size, std::string *output) {
+    z_stream zs = {};
+    if(inflateInit2(&zs, 15 + 16) != Z_OK) return false;
+
+    zs.next_in  = (Bytef *)data;
+    zs.avail_in = (uInt)size;
+    output->resize(4 * size + 4096);
+    int result;
+    do {
+        if(zs.total_out == output->size()) output->resize(2 * output->size());
+        zs.next_out  = (Bytef *)&(*output)[zs.total_out];
+        zs.avail_out = (uInt)(output->size() - zs.total_out);
+        result = inflate(&zs, Z_NO_FLUSH);
+    } while(result == Z_OK);
+    output->resize(zs.total_out);
+    inflateEnd(&zs);
+    return result == Z_STREAM_END;
+}
+
+// Write out the text of a file, compressing it first if asked to.
+static bool WriteSlvs(const Platform::Path &filename, std::string *data, bool compress) {
+    if(compress) {
+        std::string compressed;
+        if(!GzipData(*data, &compressed)) return false;
+        data->swap(compressed);
+    }
+    return Platform::WriteFile(filename, *data);
+}
+
+// Write the fields of an object of the given type; obj points to a Group for
+// type 'g', a Request for 'r', and so on.
+void SolveSpaceUI::SaveUsingTable(SlvsWriter *w, const Platform::Path &filename, int type,
+                                  const void *obj) {
+    const void *base = SavedBase(type);
     int i;
     for(i = 0; SAVED[i].type != 0; i++) {
         if(SAVED[i].type != type) continue;
 
         int fmt = SAVED[i].fmt;
-        SAVEDptr *p = (SAVEDptr *)SAVED[i].ptr;
+        ptrdiff_t offset = (const char *)SAVED[i].ptr - (const char *)base;
+        SAVEDptr *p = (SAVEDptr *)((char *)obj + offset);
         // Any items that aren't specified are assumed to be zero
         if(fmt == 'S' && p->S().empty())          continue;
         if(fmt == 'P' && p->P().IsEmpty())        continue;
@@ -235,26 +455,26 @@ void SolveSpaceUI::SaveUsingTable(const Platform::Path &filename, int type) {
         if(fmt == 'x' && p->x() == 0)             continue;
         if(fmt == 'i')                            continue;
 
-        fprintf(fh, "%s=", SAVED[i].desc);
+        w->Str(SAVED[i].desc).Char('=');
         switch(fmt) {
-            case 'S': fprintf(fh, "%s",    p->S().c_str());       break;
-            case 'b': fprintf(fh, "%d",    p->b() ? 1 : 0);       break;
-            case 'c': fprintf(fh, "%08x",  p->c().ToPackedInt()); break;
-            case 'd': fprintf(fh, "%d",    p->d());               break;
-            case 'f': fprintf(fh, "%.20f", p->f());               break;
-            case 'x': fprintf(fh, "%08x",  p->x());               break;
+            case 'S': w->Str(p->S());                    break;
+            case 'b': w->Int(p->b() ? 1 : 0);            break;
+            case 'c': w->Hex(p->c().ToPackedInt());      break;
+            case 'd': w->Int(p->d());                    break;
+            case 'f': w->Double(p->f());                 break;
+            case 'x': w->Hex(p->x());                    break;
 
             case 'P': {
                 if(!p->P().IsEmpty()) {
                     Platform::Path relativePath = p->P().RelativeTo(filename.Parent());
                     ssassert(!relativePath.IsEmpty(), "Cannot relativize path");
-                    fprintf(fh, "%s", relativePath.ToPortable().c_str());
+                    w->Str(relativePath.ToPortable());
                 }
                 break;
             }
 
             case 'M': {
-                fprintf(fh, "{\n");
+                w->Str("{\n");
                 // Sort the mapping, since EntityMap is not deterministic.
                 std::vector<std::pair<EntityKey, EntityId>> sorted(p->M().begin(), p->M().end());
                 std::sort(sorted.begin(), sorted.end(),
@@ -262,10 +482,10 @@ void SolveSpaceUI::SaveUsingTable(const Platform::Path &filename, int type) {
                         return a.second.v < b.second.v;
                     });
                 for(auto it : sorted) {
-                    fprintf(fh, "    %d %08x %d\n",
-                            it.second.v, it.first.input.v, it.first.copyNumber);
+                    w->Str("    ").Int(it.second.v).Char(' ').Hex(it.first.input.v)
+                      .Char(' ').Int(it.first.copyNumber).Char('\n');
                 }
-                fprintf(fh, "}");
+                w->Str("}");
                 break;
             }
 
@@ -273,14 +493,20 @@ void SolveSpaceUI::SaveUsingTable(const Platform::Path &filename, int type) {
 
             default: ssassert(false, "Unexpected value format");
         }
-        fprintf(fh, "\n");
+        w->Char('\n');
     }
 }
 
 bool SolveSpaceUI::SaveToFile(const Platform::Path &filename) {
     // Make sure all the entities are regenerated up to date, since they will be exported.
+    // If every group is already clean, then there's nothing to solve, and the mesh and
+    // shell are current; so just regenerate the entities.
+    bool allClean = true;
+    for(Group &g : SK.group) {
+        if(!g.clean || !g.IsSolvedOkay()) allClean = false;
+    }
     SS.ScheduleShowTW();
-    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+    SS.GenerateAll(allClean ? SolveSpaceUI::Generate::DIRTY : SolveSpaceUI::Generate::ALL);
 
     for(Group &g : SK.group) {
         if(g.type != Group::Type::LINKED) continue;
@@ -292,51 +518,40 @@ bool SolveSpaceUI::SaveToFile(const Platform::Path &filename) {
         }
     }
 
-    fh = OpenFile(filename, "wb");
-    if(!fh) {
-        Error("Couldn't write to file '%s'", filename.raw.c_str());
-        return false;
-    }
-
-    fprintf(fh, "%s\n\n\n", VERSION_STRING);
+    SlvsWriter w;
+    w.Str(VERSION_STRING "\n\n\n");
 
     int i, j;
     for(auto &g : SK.group) {
-        sv.g = g;
-        SaveUsingTable(filename, 'g');
-        fprintf(fh, "AddGroup\n\n");
+        SaveUsingTable(&w, filename, 'g', &g);
+        w.Str("AddGroup\n\n");
     }
 
     for(auto &p : SK.param) {
-        sv.p = p;
-        SaveUsingTable(filename, 'p');
-        fprintf(fh, "AddParam\n\n");
+        SaveUsingTable(&w, filename, 'p', &p);
+        w.Str("AddParam\n\n");
     }
 
     for(auto &r : SK.request) {
-        sv.r = r;
-        SaveUsingTable(filename, 'r');
-        fprintf(fh, "AddRequest\n\n");
+        SaveUsingTable(&w, filename, 'r', &r);
+        w.Str("AddRequest\n\n");
     }
 
     for(auto &e : SK.entity) {
         e.CalculateNumerical(/*forExport=*/true);
-        sv.e = e;
-        SaveUsingTable(filename, 'e');
-        fprintf(fh, "AddEntity\n\n");
+        SaveUsingTable(&w, filename, 'e', &e);
+        w.Str("AddEntity\n\n");
     }
 
     for(auto &c : SK.constraint) {
-        sv.c = c;
-        SaveUsingTable(filename, 'c');
-        fprintf(fh, "AddConstraint\n\n");
+        SaveUsingTable(&w, filename, 'c', &c);
+        w.Str("AddConstraint\n\n");
     }
 
     for(auto &s : SK.style) {
-        sv.s = s;
-        if(sv.s.h.v >= Style::FIRST_CUSTOM) {
-            SaveUsingTable(filename, 's');
-            fprintf(fh, "AddStyle\n\n");
+        if(s.h.v >= Style::FIRST_CUSTOM) {
+            SaveUsingTable(&w, filename, 's', &s);
+            w.Str("AddStyle\n\n");
         }
     }
 
@@ -347,131 +562,449 @@ bool SolveSpaceUI::SaveToFile(const Platform::Path &filename) {
     SMesh *m = &g->runningMesh;
     for(i = 0; i < m->l.n; i++) {
         STriangle *tr = &(m->l[i]);
-        fprintf(fh, "Triangle %08x %08x "
-                "%.20f %.20f %.20f  %.20f %.20f %.20f  %.20f %.20f %.20f\n",
-            tr->meta.face, tr->meta.color.ToPackedInt(),
-            CO(tr->a), CO(tr->b), CO(tr->c));
+        w.Str("Triangle ").Hex(tr->meta.face).Char(' ').Hex(tr->meta.color.ToPackedInt())
+         .Char(' ').Vec(tr->a).Str("  ").Vec(tr->b).Str("  ").Vec(tr->c).Char('\n');
     }
 
     SShell *s = &g->runningShell;
     for(SSurface &srf : s->surface) {
-        fprintf(fh, "Surface %08x %08x %08x %d %d\n",
-            srf.h.v, srf.color.ToPackedInt(), srf.face, srf.degm, srf.degn);
+        w.Str("Surface ").Hex(srf.h.v).Char(' ').Hex(srf.color.ToPackedInt())
+         .Char(' ').Hex(srf.face).Char(' ').Int(srf.degm).Char(' ').Int(srf.degn).Char('\n');
         for(i = 0; i <= srf.degm; i++) {
             for(j = 0; j <= srf.degn; j++) {
-                fprintf(fh, "SCtrl %d %d %.20f %.20f %.20f Weight %20.20f\n",
-                    i, j, CO(srf.ctrl[i][j]), srf.weight[i][j]);
+                w.Str("SCtrl ").Int(i).Char(' ').Int(j).Char(' ').Vec(srf.ctrl[i][j])
+                 .Str(" Weight ").Double(srf.weight[i][j]).Char('\n');
             }
         }
 
         STrimBy *stb;
         for(stb = srf.trim.First(); stb; stb = srf.trim.NextAfter(stb)) {
-            fprintf(fh, "TrimBy %08x %d %.20f %.20f %.20f  %.20f %.20f %.20f\n",
-                stb->curve.v, stb->backwards ? 1 : 0,
-                CO(stb->start), CO(stb->finish));
+            w.Str("TrimBy ").Hex(stb->curve.v).Char(' ').Int(stb->backwards ? 1 : 0)
+             .Char(' ').Vec(stb->start).Str("  ").Vec(stb->finish).Char('\n');
         }
 
-        fprintf(fh, "AddSurface\n");
+        w.Str("AddSurface\n");
     }
     for(SCurve &sc : s->curve) {
-        fprintf(fh, "Curve %08x %d %d %08x %08x\n",
-            sc.h.v,
-            sc.isExact ? 1 : 0, sc.exact.deg,
-            sc.surfA.v, sc.surfB.v);
+        w.Str("Curve ").Hex(sc.h.v).Char(' ').Int(sc.isExact ? 1 : 0)
+         .Char(' ').Int(sc.exact.deg).Char(' ').Hex(sc.surfA.v).Char(' ').Hex(sc.surfB.v)
+         .Char('\n');
 
         if(sc.isExact) {
             for(i = 0; i <= sc.exact.deg; i++) {
-                fprintf(fh, "CCtrl %d %.20f %.20f %.20f Weight %.20f\n",
-                    i, CO(sc.exact.ctrl[i]), sc.exact.weight[i]);
+                w.Str("CCtrl ").Int(i).Char(' ').Vec(sc.exact.ctrl[i])
+                 .Str(" Weight ").Double(sc.exact.weight[i]).Char('\n');
             }
         }
         SCurvePt *scpt;
         for(scpt = sc.pts.First(); scpt; scpt = sc.pts.NextAfter(scpt)) {
-            fprintf(fh, "CurvePt %d %.20f %.20f %.20f\n",
-                scpt->vertex ? 1 : 0, CO(scpt->p));
+            w.Str("CurvePt ").Int(scpt->vertex ? 1 : 0).Char(' ').Vec(scpt->p).Char('\n');
         }
 
-        fprintf(fh, "AddCurve\n");
+        w.Str("AddCurve\n");
     }
 
-    fclose(fh);
+    if(!WriteSlvs(filename, &w.data, compressSavedFiles)) {
+        Error("Couldn't write to file '%s'", filename.raw.c_str());
+        return false;
+    }
 
     return true;
 }
 
-void SolveSpaceUI::LoadUsingTable(const Platform::Path &filename, char *key, char *val) {
-    int i;
-    for(i = 0; SAVED[i].type != 0; i++) {
-        if(strcmp(SAVED[i].desc, key)==0) {
-            SAVEDptr *p = (SAVEDptr *)SAVED[i].ptr;
-            unsigned int u = 0;
-            switch(SAVED[i].fmt) {
-                case 'S': p->S() = val;                     break;
-                case 'b': p->b() = (atoi(val) != 0);        break;
-                case 'd': p->d() = atoi(val);               break;
-                case 'f': p->f() = atof(val);               break;
-                case 'x': sscanf(val, "%x", &u); p->x()= u; break;
-
-                case 'P': {
-                    Platform::Path path = Platform::Path::FromPortable(val);
-                    if(!path.IsEmpty()) {
-                        p->P() = filename.Parent().Join(path).Expand();
-                    }
-                    break;
-                }
+//-----------------------------------------------------------------------------
+// Write the sketch recorded in an undo state. This reads nothing but the state,
+// so it may run on another thread while the user keeps editing. Only what's
+// needed to load the sketch again is written; the entities, mesh and shell are
+// left out, since they're regenerated on load anyway.
+//-----------------------------------------------------------------------------
+bool SolveSpaceUI::SaveStateToFile(const UndoState &state, const Platform::Path &filename,
+                                   bool compress) {
+    for(const auto &g : state.group) {
+        if(g->type == Group::Type::LINKED && g->linkFile.RelativeTo(filename).IsEmpty()) {
+            return false;
+        }
+    }
 
-                case 'c':
-                    sscanf(val, "%x", &u);
-                    p->c() = RgbaColor::FromPackedInt(u);
-                    break;
+    SlvsWriter w;
+    w.Str(VERSION_STRING "\n\n\n");
+
+    for(const auto &g : state.group) {
+        SaveUsingTable(&w, filename, 'g', g.get());
+        w.Str("AddGroup\n\n");
+    }
 
-                case 'M': {
-                    p->M().clear();
-                    for(;;) {
-                        EntityKey ek;
-                        EntityId ei;
-                        char line2[1024];
-                        if (fgets(line2, (int)sizeof(line2), fh) == NULL)
-                            break;
-                        if(sscanf(line2, "%d %x %d", &(ei.v), &(ek.input.v),
-                                                     &(ek.copyNumber)) == 3) {
-                            if(ei.v == Entity::NO_ENTITY.v) {
-                                // Commit bd84bc1a mistakenly introduced code that would remap
-                                // some entities to NO_ENTITY. This was fixed in commit bd84bc1a,
-                                // but files created meanwhile are corrupt, and can cause crashes.
-                                //
-                                // To fix this, we skip any such remaps when loading; they will be
-                                // recreated on the next regeneration. Any resulting orphans will
-                                // be pruned in the usual way, recovering to a well-defined state.
-                                continue;
-                            }
-                            p->M().insert({ ek, ei });
-                        } else {
-                            break;
-                        }
+    for(const auto &p : state.param) {
+        SaveUsingTable(&w, filename, 'p', p.get());
+        w.Str("AddParam\n\n");
+    }
+
+    for(const auto &r : state.request) {
+        SaveUsingTable(&w, filename, 'r', r.get());
+        w.Str("AddRequest\n\n");
+    }
+
+    for(const auto &c : state.constraint) {
+        SaveUsingTable(&w, filename, 'c', c.get());
+        w.Str("AddConstraint\n\n");
+    }
+
+    for(const auto &s : state.style) {
+        if(s->h.v >= Style::FIRST_CUSTOM) {
+            SaveUsingTable(&w, filename, 's', s.get());
+            w.Str("AddStyle\n\n");
+        }
+    }
+
+    // Write to a temporary file first, so that if we're interrupted, we don't
+    // leave a truncated file behind.
+    Platform::Path tempFile = Platform::Path::From(filename.raw + ".tmp");
+    if(!WriteSlvs(tempFile, &w.data, compress)) {
+        RemoveFile(tempFile);
+        return false;
+    }
+    return RenameFile(tempFile, filename);
+}
+
+//-----------------------------------------------------------------------------
+// Parsers for the numbers in our files, which are much faster than atoi(),
+// sscanf() and atof() on what we write, and give identical results. Each
+// reads from the text in [p, end), which needn't be null-terminated, and
+// returns a pointer just past the number, or NULL if there isn't one.
+//-----------------------------------------------------------------------------
+static const char *SkipSpace(const char *p, const char *end) {
+    while(p < end && isspace(*p)) p++;
+    return p;
+}
+
+static const char *ParseInt(const char *p, const char *end, int *result) {
+    p = SkipSpace(p, end);
+    bool negative = (p < end && *p == '-');
+    if(p < end && (*p == '-' || *p == '+')) p++;
+
+    const char *start = p;
+    unsigned value = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; p++) {
+        value = value * 10 + (unsigned)(*p - '0');
+    }
+    *result = (int)(negative ? 0u - value : value);
+    return (p == start) ? NULL : p;
+}
+
+static const char *ParseHex(const char *p, const char *end, uint32_t *result) {
+    p = SkipSpace(p, end);
+    bool negative = (p < end && *p == '-');
+    if(p < end && (*p == '-' || *p == '+')) p++;
+    if(end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && isxdigit(p[2])) p += 2;
+
+    const char *start = p;
+    uint32_t value = 0;
+    for(; p < end; p++) {
+        char c = *p;
+        if(c >= '0' && c <= '9') {
+            value = (value << 4) | (uint32_t)(c - '0');
+        } else if(c >= 'a' && c <= 'f') {
+            value = (value << 4) | (uint32_t)(c - 'a' + 10);
+        } else if(c >= 'A' && c <= 'F') {
+            value = (value << 4) | (uint32_t)(c - 'A' + 10);
+        } else break;
+    }
+    *result = negative ? 0u - value : value;
+    return (p == start) ? NULL : p;
+}
+
+// For anything unusual, strtod() needs a null-terminated copy of the number.
+static const char *ParseDoubleSlow(const char *p, const char *end, double *result) {
+    const char *q = p;
+    while(q < end && (isalnum(*q) || *q == '.' || *q == '+' || *q == '-')) q++;
+
+    std::string str(p, q);
+    char *strEnd;
+    *result = strtod(str.c_str(), &strEnd);
+    return (strEnd == str.c_str()) ? NULL : p + (strEnd - str.c_str());
+}
+
+// A decimal with at most 15 significant digits (ignoring trailing zeros) and
+// a small enough scale is a product or quotient of two exactly representable
+// doubles, so a single correctly rounded operation gives the same answer as
+// strtod(). That covers most of what we write; everything else goes to strtod().
+static const char *ParseDouble(const char *p, const char *end, double *result) {
+    static const double POW10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    p = SkipSpace(p, end);
+    const char *start = p;
+    bool negative = (p < end && *p == '-');
+    if(p < end && (*p == '-' || *p == '+')) p++;
+
+    uint64_t mantissa = 0;
+    int  significant = 0, fracDigits = 0;
+    int  pendingIntZeros = 0, pendingFracZeros = 0;
+    bool inFraction = false, sawDigit = false;
+    for(; p < end; p++) {
+        if(*p == '.' && !inFraction) {
+            inFraction = true;
+        } else if(*p == '0') {
+            sawDigit = true;
+            if(inFraction) pendingFracZeros++; else pendingIntZeros++;
+        } else if(*p >= '1' && *p <= '9') {
+            sawDigit = true;
+            int zeros = pendingIntZeros + pendingFracZeros;
+            significant = (mantissa == 0) ? 1 : significant + zeros + 1;
+            if(significant > 15) return ParseDoubleSlow(start, end, result);
+            for(int i = 0; i < zeros; i++) mantissa *= 10;
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            fracDigits += pendingFracZeros + (inFraction ? 1 : 0);
+            pendingIntZeros = pendingFracZeros = 0;
+        } else if(*p == 'e' || *p == 'E') {
+            return ParseDoubleSlow(start, end, result);
+        } else break;
+    }
+    if(!sawDigit) return ParseDoubleSlow(start, end, result);
+
+    // Any zeros left over in the fraction are trailing, and don't matter.
+    int scale = pendingIntZeros - fracDigits;
+    double value;
+    if(mantissa == 0) {
+        value = 0.0;
+    } else if(scale >= 0 && scale <= 22 && significant + scale <= 15) {
+        value = (double)mantissa * POW10[scale];
+    } else if(scale < 0 && scale >= -22) {
+        value = (double)mantissa / POW10[-scale];
+    } else {
+        return ParseDoubleSlow(start, end, result);
+    }
+    *result = negative ? -value : value;
+    return p;
+}
+
+//-----------------------------------------------------------------------------
+// A reader for our file format, which maps the file into memory and then
+// finds each line, and the key and value of an assignment, in place. Lines
+// end with \n; anything from a \r onwards is ignored, since mailers will
+// sometimes mangle attachments.
+//-----------------------------------------------------------------------------
+class SolveSpace::SlvsReader {
+public:
+    Platform::MappedFile file;
+    const char *pos, *end;
+
+    const char *line, *lineEnd;
+    // If the line is an assignment, then its key and value; else key is NULL.
+    const char *key, *keyEnd;
+    const char *val, *valEnd;
+
+    // If the file is compressed, then its decompressed text.
+    std::string inflated;
+
+    bool Open(const Platform::Path &filename) {
+        if(!file.Map(filename)) return false;
+        if(IsGzipData(file.data, file.size)) {
+            if(!GunzipData(file.data, file.size, &inflated)) return false;
+            pos = inflated.data();
+            end = inflated.data() + inflated.size();
+        } else {
+            pos = file.data;
+            end = file.data + file.size;
+        }
+        return true;
+    }
+
+    bool NextLine() {
+        if(pos >= end) return false;
+
+        line = pos;
+        const char *nl = (const char *)memchr(pos, '\n', end - pos);
+        pos     = nl ? nl + 1 : end;
+        lineEnd = nl ? nl     : end;
+        const char *cr = (const char *)memchr(line, '\r', lineEnd - line);
+        if(cr) lineEnd = cr;
+
+        const char *eq = (const char *)memchr(line, '=', lineEnd - line);
+        if(eq) {
+            key = line;   keyEnd = eq;
+            val = eq + 1; valEnd = lineEnd;
+        } else {
+            key = keyEnd = val = valEnd = NULL;
+        }
+        return true;
+    }
+
+    bool IsEmpty() const { return line == lineEnd; }
+
+    bool Is(const char *str) const {
+        size_t len = strlen(str);
+        return (size_t)(lineEnd - line) == len && memcmp(line, str, len) == 0;
+    }
+
+    // If the line starts with the given word, then the rest of the line.
+    const char *After(const char *word) const {
+        size_t len = strlen(word);
+        if((size_t)(lineEnd - line) < len || memcmp(line, word, len) != 0) return NULL;
+        return line + len;
+    }
+};
+
+namespace SolveSpace {
+
+// Reads the fields of a record such as "Triangle ..." in turn; any field that
+// is missing or malformed makes the whole record bad.
+class RecordReader {
+public:
+    const char *pos, *end;
+    bool        ok;
+
+    RecordReader(const char *pos, const char *end) : pos(pos), end(end), ok(pos != NULL) {}
+
+    void Int(int *result)       { if(ok) Field(ParseInt(pos, end, result));    }
+    void Hex(uint32_t *result)  { if(ok) Field(ParseHex(pos, end, result));    }
+    void Double(double *result) { if(ok) Field(ParseDouble(pos, end, result)); }
+    void Vec(Vector *result)    { Double(&result->x); Double(&result->y); Double(&result->z); }
+
+    void Word(const char *word) {
+        if(!ok) return;
+        pos = SkipSpace(pos, end);
+        size_t len = strlen(word);
+        if((size_t)(end - pos) >= len && memcmp(pos, word, len) == 0) {
+            pos += len;
+        } else {
+            ok = false;
+        }
+    }
+
+private:
+    void Field(const char *next) {
+        if(next == NULL) {
+            ok = false;
+        } else {
+            pos = next;
+        }
+    }
+};
+
+}
+
+//-----------------------------------------------------------------------------
+// An index of SAVED[] by key, so that each line of a file needn't be compared
+// against every key in turn. It's an open-addressed hash table, built on first
+// use; each slot holds an index into SAVED[] plus one, or zero if unused.
+//-----------------------------------------------------------------------------
+static uint32_t HashSavedKey(const char *key, size_t length) {
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < length; i++) {
+        h = (h ^ (uint8_t)key[i]) * 16777619u;
+    }
+    return h;
+}
+
+static std::vector<uint16_t> BuildSavedIndex(size_t slotCount) {
+    std::vector<uint16_t> slots(slotCount);
+    for(int i = 0; SolveSpaceUI::SAVED[i].type != 0; i++) {
+        const char *desc = SolveSpaceUI::SAVED[i].desc;
+        ssassert(2 * (size_t)(i + 1) < slotCount, "Too many keys for table");
+        uint32_t j = HashSavedKey(desc, strlen(desc)) & (slotCount - 1);
+        while(slots[j] != 0) {
+            j = (j + 1) & (slotCount - 1);
+        }
+        slots[j] = (uint16_t)(i + 1);
+    }
+    return slots;
+}
+
+int SolveSpaceUI::FindSavedByKey(const char *key, size_t length) {
+    enum { SLOTS = 512 };
+    // Initialized just once, even if several files are being read at once.
+    static const std::vector<uint16_t> slots = BuildSavedIndex(SLOTS);
+
+    uint32_t j = HashSavedKey(key, length) & (SLOTS - 1);
+    while(slots[j] != 0) {
+        int i = slots[j] - 1;
+        if(strncmp(SAVED[i].desc, key, length) == 0 && SAVED[i].desc[length] == '\0') return i;
+        j = (j + 1) & (SLOTS - 1);
+    }
+    return -1;
+}
+
+bool SolveSpaceUI::LoadUsingTable(const Platform::Path &filename, SlvsReader *reader,
+                                  SaveData *data) {
+    int i = FindSavedByKey(reader->key, reader->keyEnd - reader->key);
+    if(i < 0) return false;
+
+    const char *val = reader->val, *valEnd = reader->valEnd;
+    SAVEDptr *p = SavedField(&SAVED[i], data);
+    int d = 0;
+    double f = 0.0;
+    uint32_t x = 0;
+    switch(SAVED[i].fmt) {
+        case 'S': p->S().assign(val, valEnd);                       break;
+        case 'b': ParseInt(val, valEnd, &d);    p->b() = (d != 0);  break;
+        case 'd': ParseInt(val, valEnd, &d);    p->d() = d;         break;
+        case 'f': ParseDouble(val, valEnd, &f); p->f() = f;         break;
+        case 'x': ParseHex(val, valEnd, &x);    p->x() = x;         break;
+
+        case 'P': {
+            Platform::Path path = Platform::Path::FromPortable(std::string(val, valEnd));
+            if(!path.IsEmpty()) {
+                p->P() = filename.Parent().Join(path).Expand();
+            }
+            break;
+        }
+
+        case 'c':
+            ParseHex(val, valEnd, &x);
+            p->c() = RgbaColor::FromPackedInt(x);
+            break;
+
+        case 'M': {
+            p->M().clear();
+            for(;;) {
+                EntityKey ek;
+                EntityId ei;
+                if(!reader->NextLine())
+                    break;
+                RecordReader record(reader->line, reader->lineEnd);
+                int id;
+                record.Int(&id);
+                record.Hex(&(ek.input.v));
+                record.Int(&(ek.copyNumber));
+                if(record.ok) {
+                    ei.v = (uint32_t)id;
+                    if(ei.v == Entity::NO_ENTITY.v) {
+                        // Commit bd84bc1a mistakenly introduced code that would remap
+                        // some entities to NO_ENTITY. This was fixed in commit bd84bc1a,
+                        // but files created meanwhile are corrupt, and can cause crashes.
+                        //
+                        // To fix this, we skip any such remaps when loading; they will be
+                        // recreated on the next regeneration. Any resulting orphans will
+                        // be pruned in the usual way, recovering to a well-defined state.
+                        continue;
                     }
+                    p->M().insert({ ek, ei });
+                } else {
                     break;
                 }
-
-                case 'i': break;
-
-                default: ssassert(false, "Unexpected value format");
             }
             break;
         }
+
+        case 'i': break;
+
+        default: ssassert(false, "Unexpected value format");
     }
-    if(SAVED[i].type == 0) {
-        fileLoadError = true;
-    }
+    return true;
 }
 
 bool SolveSpaceUI::LoadFromFile(const Platform::Path &filename, bool canCancel) {
+    ProfileScope profile(hGroup{}, Profile::Phase::LOAD_FILE);
+
     bool fileIsEmpty = true;
     allConsistent = false;
     fileLoadError = false;
 
-    fh = OpenFile(filename, "rb");
-    if(!fh) {
+    SlvsReader reader;
+    if(!reader.Open(filename)) {
         Error("Couldn't read from file '%s'", filename.raw.c_str());
         return false;
     }
@@ -482,25 +1015,16 @@ bool SolveSpaceUI::LoadFromFile(const Platform::Path &filename, bool canCancel)
     sv.g.scale = 1; // default is 1, not 0; so legacy files need this
     Style::FillDefaultStyle(&sv.s);
 
-    char line[1024];
-    while(fgets(line, (int)sizeof(line), fh)) {
+    while(reader.NextLine()) {
         fileIsEmpty = false;
 
-        char *s = strchr(line, '\n');
-        if(s) *s = '\0';
-        // We should never get files with \r characters in them, but mailers
-        // will sometimes mangle attachments.
-        s = strchr(line, '\r');
-        if(s) *s = '\0';
-
-        if(*line == '\0') continue;
-
-        char *e = strchr(line, '=');
-        if(e) {
-            *e = '\0';
-            char *key = line, *val = e+1;
-            LoadUsingTable(filename, key, val);
-        } else if(strcmp(line, "AddGroup")==0) {
+        if(reader.IsEmpty()) continue;
+
+        if(reader.key) {
+            if(!LoadUsingTable(filename, &reader, &sv)) {
+                fileLoadError = true;
+            }
+        } else if(reader.Is("AddGroup")) {
             // legacy files have a spurious dependency between linked groups
             // and their parent groups, remove
             if(sv.g.type == Group::Type::LINKED)
@@ -509,42 +1033,41 @@ bool SolveSpaceUI::LoadFromFile(const Platform::Path &filename, bool canCancel)
             SK.group.Add(&(sv.g));
             sv.g = {};
             sv.g.scale = 1; // default is 1, not 0; so legacy files need this
-        } else if(strcmp(line, "AddParam")==0) {
+        } else if(reader.Is("AddParam")) {
             // params are regenerated, but we want to preload the values
             // for initial guesses
             SK.param.Add(&(sv.p));
             sv.p = {};
-        } else if(strcmp(line, "AddEntity")==0) {
+        } else if(reader.Is("AddEntity")) {
             // entities are regenerated
-        } else if(strcmp(line, "AddRequest")==0) {
+        } else if(reader.Is("AddRequest")) {
             SK.request.Add(&(sv.r));
             sv.r = {};
-        } else if(strcmp(line, "AddConstraint")==0) {
+        } else if(reader.Is("AddConstraint")) {
             SK.constraint.Add(&(sv.c));
             sv.c = {};
-        } else if(strcmp(line, "AddStyle")==0) {
+        } else if(reader.Is("AddStyle")) {
             SK.style.Add(&(sv.s));
             sv.s = {};
             Style::FillDefaultStyle(&sv.s);
-        } else if(strcmp(line, VERSION_STRING)==0) {
+        } else if(reader.Is(VERSION_STRING)) {
             // do nothing, version string
-        } else if(StrStartsWith(line, "Triangle ")      ||
-                  StrStartsWith(line, "Surface ")       ||
-                  StrStartsWith(line, "SCtrl ")         ||
-                  StrStartsWith(line, "TrimBy ")        ||
-                  StrStartsWith(line, "Curve ")         ||
-                  StrStartsWith(line, "CCtrl ")         ||
-                  StrStartsWith(line, "CurvePt ")       ||
-                  strcmp(line, "AddSurface")==0         ||
-                  strcmp(line, "AddCurve")==0)
+        } else if(reader.After("Triangle ")     ||
+                  reader.After("Surface ")      ||
+                  reader.After("SCtrl ")        ||
+                  reader.After("TrimBy ")       ||
+                  reader.After("Curve ")        ||
+                  reader.After("CCtrl ")        ||
+                  reader.After("CurvePt ")      ||
+                  reader.Is("AddSurface")       ||
+                  reader.Is("AddCurve"))
         {
             // ignore the mesh or shell, since we regenerate that
         } else {
             fileLoadError = true;
         }
     }
-
-    fclose(fh);
+    reader.file.Unmap();
 
     if(fileIsEmpty) {
         Error(_("The file is empty. It may be corrupt."));
@@ -706,153 +1229,553 @@ void SolveSpaceUI::UpgradeLegacyData() {
     oldParam.Clear();
 }
 
-bool SolveSpaceUI::LoadEntitiesFromFile(const Platform::Path &filename, EntityList *le,
-                                        SMesh *m, SShell *sh)
+bool SolveSpaceUI::LoadEntitiesFromFile(const Platform::Path &filename, LinkedSketch *ls)
 {
     if(strcmp(filename.Extension().c_str(), "emn")==0) {
-        return LinkIDF(filename, le, m, sh);    
+        return LinkIDF(filename, &ls->entity, &ls->mesh, &ls->shell);
     } else {
-        return LoadEntitiesFromSlvs(filename, le, m, sh);
+        return LoadEntitiesFromSlvs(filename, ls);
     }
 }
 
-bool SolveSpaceUI::LoadEntitiesFromSlvs(const Platform::Path &filename, EntityList *le,
-                                        SMesh *m, SShell *sh)
+// This touches nothing but its arguments (and the cache file), so that any
+// number of linked files can be read at once.
+bool SolveSpaceUI::LoadEntitiesFromSlvs(const Platform::Path &filename, LinkedSketch *ls)
 {
+    EntityList *le = &ls->entity;
+    SMesh *m = &ls->mesh;
+    SShell *sh = &ls->shell;
     SSurface srf = {};
     SCurve crv = {};
 
-    fh = OpenFile(filename, "rb");
-    if(!fh) return false;
+    SlvsReader reader;
+    if(!reader.Open(filename)) return false;
 
-    le->Clear();
-    sv = {};
+    if(cacheLinkedFiles && LoadLinkedCache(filename, reader.file, ls)) {
+        return true;
+    }
+    SaveData sv = {};
 
-    char line[1024];
-    while(fgets(line, (int)sizeof(line), fh)) {
-        char *s = strchr(line, '\n');
-        if(s) *s = '\0';
-        // We should never get files with \r characters in them, but mailers
-        // will sometimes mangle attachments.
-        s = strchr(line, '\r');
-        if(s) *s = '\0';
-
-        if(*line == '\0') continue;
-
-        char *e = strchr(line, '=');
-        if(e) {
-            *e = '\0';
-            char *key = line, *val = e+1;
-            LoadUsingTable(filename, key, val);
-        } else if(strcmp(line, "AddGroup")==0) {
+    const char *rest;
+    while(reader.NextLine()) {
+        if(reader.IsEmpty()) continue;
+
+        if(reader.key) {
+            if(!LoadUsingTable(filename, &reader, &sv)) {
+                ls->loadError = true;
+            }
+        } else if(reader.Is("AddGroup")) {
             // These get allocated whether we want them or not.
             sv.g.remap.clear();
-        } else if(strcmp(line, "AddParam")==0) {
+        } else if(reader.Is("AddParam")) {
 
-        } else if(strcmp(line, "AddEntity")==0) {
+        } else if(reader.Is("AddEntity")) {
             le->Add(&(sv.e));
             sv.e = {};
-        } else if(strcmp(line, "AddRequest")==0) {
+        } else if(reader.Is("AddRequest")) {
 
-        } else if(strcmp(line, "AddConstraint")==0) {
+        } else if(reader.Is("AddConstraint")) {
 
-        } else if(strcmp(line, "AddStyle")==0) {
-            // Linked file contains a style that we don't have yet,
-            // so import it.
-            if (SK.style.FindByIdNoOops(sv.s.h) == nullptr) {
-                SK.style.Add(&(sv.s));
-            }
+        } else if(reader.Is("AddStyle")) {
+            // The caller imports these, if we don't have them yet.
+            ls->style.push_back(sv.s);
             sv.s = {};
             Style::FillDefaultStyle(&sv.s);
-        } else if(strcmp(line, VERSION_STRING)==0) {
+        } else if(reader.Is(VERSION_STRING)) {
 
-        } else if(StrStartsWith(line, "Triangle ")) {
+        } else if((rest = reader.After("Triangle "))) {
             STriangle tr = {};
-            unsigned int rgba = 0;
-            if(sscanf(line, "Triangle %x %x  "
-                             "%lf %lf %lf  %lf %lf %lf  %lf %lf %lf",
-                &(tr.meta.face), &rgba,
-                &(tr.a.x), &(tr.a.y), &(tr.a.z),
-                &(tr.b.x), &(tr.b.y), &(tr.b.z),
-                &(tr.c.x), &(tr.c.y), &(tr.c.z)) != 11) {
-                ssassert(false, "Unexpected Triangle format");
-            }
-            tr.meta.color = RgbaColor::FromPackedInt((uint32_t)rgba);
+            uint32_t rgba = 0;
+            RecordReader record(rest, reader.lineEnd);
+            record.Hex(&(tr.meta.face));
+            record.Hex(&rgba);
+            record.Vec(&(tr.a));
+            record.Vec(&(tr.b));
+            record.Vec(&(tr.c));
+            ssassert(record.ok, "Unexpected Triangle format");
+            tr.meta.color = RgbaColor::FromPackedInt(rgba);
             m->AddTriangle(&tr);
-        } else if(StrStartsWith(line, "Surface ")) {
-            unsigned int rgba = 0;
-            if(sscanf(line, "Surface %x %x %x %d %d",
-                &(srf.h.v), &rgba, &(srf.face),
-                &(srf.degm), &(srf.degn)) != 5) {
-                ssassert(false, "Unexpected Surface format");
-            }
-            srf.color = RgbaColor::FromPackedInt((uint32_t)rgba);
-        } else if(StrStartsWith(line, "SCtrl ")) {
+        } else if((rest = reader.After("Surface "))) {
+            uint32_t rgba = 0;
+            RecordReader record(rest, reader.lineEnd);
+            record.Hex(&(srf.h.v));
+            record.Hex(&rgba);
+            record.Hex(&(srf.face));
+            record.Int(&(srf.degm));
+            record.Int(&(srf.degn));
+            ssassert(record.ok, "Unexpected Surface format");
+            srf.color = RgbaColor::FromPackedInt(rgba);
+        } else if((rest = reader.After("SCtrl "))) {
             int i, j;
             Vector c;
             double w;
-            if(sscanf(line, "SCtrl %d %d %lf %lf %lf Weight %lf",
-                                &i, &j, &(c.x), &(c.y), &(c.z), &w) != 6)
-            {
-                ssassert(false, "Unexpected SCtrl format");
-            }
+            RecordReader record(rest, reader.lineEnd);
+            record.Int(&i);
+            record.Int(&j);
+            record.Vec(&c);
+            record.Word("Weight");
+            record.Double(&w);
+            ssassert(record.ok, "Unexpected SCtrl format");
             srf.ctrl[i][j] = c;
             srf.weight[i][j] = w;
-        } else if(StrStartsWith(line, "TrimBy ")) {
+        } else if((rest = reader.After("TrimBy "))) {
             STrimBy stb = {};
             int backwards;
-            if(sscanf(line, "TrimBy %x %d  %lf %lf %lf  %lf %lf %lf",
-                &(stb.curve.v), &backwards,
-                &(stb.start.x), &(stb.start.y), &(stb.start.z),
-                &(stb.finish.x), &(stb.finish.y), &(stb.finish.z)) != 8)
-            {
-                ssassert(false, "Unexpected TrimBy format");
-            }
+            RecordReader record(rest, reader.lineEnd);
+            record.Hex(&(stb.curve.v));
+            record.Int(&backwards);
+            record.Vec(&(stb.start));
+            record.Vec(&(stb.finish));
+            ssassert(record.ok, "Unexpected TrimBy format");
             stb.backwards = (backwards != 0);
             srf.trim.Add(&stb);
-        } else if(strcmp(line, "AddSurface")==0) {
+        } else if(reader.Is("AddSurface")) {
             sh->surface.Add(&srf);
             srf = {};
-        } else if(StrStartsWith(line, "Curve ")) {
+        } else if((rest = reader.After("Curve "))) {
             int isExact;
-            if(sscanf(line, "Curve %x %d %d %x %x",
-                &(crv.h.v),
-                &(isExact),
-                &(crv.exact.deg),
-                &(crv.surfA.v), &(crv.surfB.v)) != 5)
-            {
-                ssassert(false, "Unexpected Curve format");
-            }
+            RecordReader record(rest, reader.lineEnd);
+            record.Hex(&(crv.h.v));
+            record.Int(&isExact);
+            record.Int(&(crv.exact.deg));
+            record.Hex(&(crv.surfA.v));
+            record.Hex(&(crv.surfB.v));
+            ssassert(record.ok, "Unexpected Curve format");
             crv.isExact = (isExact != 0);
-        } else if(StrStartsWith(line, "CCtrl ")) {
+        } else if((rest = reader.After("CCtrl "))) {
             int i;
             Vector c;
             double w;
-            if(sscanf(line, "CCtrl %d %lf %lf %lf Weight %lf",
-                                &i, &(c.x), &(c.y), &(c.z), &w) != 5)
-            {
-                ssassert(false, "Unexpected CCtrl format");
-            }
+            RecordReader record(rest, reader.lineEnd);
+            record.Int(&i);
+            record.Vec(&c);
+            record.Word("Weight");
+            record.Double(&w);
+            ssassert(record.ok, "Unexpected CCtrl format");
             crv.exact.ctrl[i] = c;
             crv.exact.weight[i] = w;
-        } else if(StrStartsWith(line, "CurvePt ")) {
+        } else if((rest = reader.After("CurvePt "))) {
             SCurvePt scpt;
             int vertex;
-            if(sscanf(line, "CurvePt %d %lf %lf %lf",
-                &vertex,
-                &(scpt.p.x), &(scpt.p.y), &(scpt.p.z)) != 4)
-            {
-                ssassert(false, "Unexpected CurvePt format");
-            }
+            RecordReader record(rest, reader.lineEnd);
+            record.Int(&vertex);
+            record.Vec(&(scpt.p));
+            ssassert(record.ok, "Unexpected CurvePt format");
             scpt.vertex = (vertex != 0);
             crv.pts.Add(&scpt);
-        } else if(strcmp(line, "AddCurve")==0) {
+        } else if(reader.Is("AddCurve")) {
             sh->curve.Add(&crv);
             crv = {};
         } else ssassert(false, "Unexpected operation");
     }
 
-    fclose(fh);
+    if(cacheLinkedFiles) {
+        SaveLinkedCache(filename, reader.file, ls);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// A cache of what LoadEntitiesFromSlvs() reads from a linked file, kept beside
+// that file in a binary format that can be read back without any parsing. The
+// cache records the size and a hash of the file that it was made from, and is
+// ignored (and then rewritten) unless the file is still byte-for-byte the same.
+//-----------------------------------------------------------------------------
+static const char     LINKED_CACHE_MAGIC[8]   = { 'S', 'l', 'v', 's', 'L', 'i', 'n', 'k' };
+// Bump this when the layout of the mesh or shell in the cache changes; any
+// change to the entities or styles, which are written using SAVED[], is
+// caught by LinkedCacheVersion() without it.
+static const uint32_t LINKED_CACHE_FORMAT     = 2;
+static const uint32_t LINKED_CACHE_BYTE_ORDER = 0x01020304;
+
+static Platform::Path LinkedCachePath(const Platform::Path &filename) {
+    return Platform::Path::From(filename.raw + ".cache");
+}
+
+static uint64_t HashFileContents(const char *data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ word) * 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+    for(; i < size; i++) {
+        h = (h ^ (uint8_t)data[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+// The version of the cache format: LINKED_CACHE_FORMAT, along with a hash of
+// the entries of SAVED[] that we write, so that adding, removing or changing
+// one makes old caches stale.
+static uint32_t LinkedCacheVersion() {
+    static const uint32_t version = [] {
+        uint32_t h = 2166136261u;
+        auto hashByte = [&](uint8_t b) { h = (h ^ b) * 16777619u; };
+        for(int i = 0; i < 4; i++) hashByte((uint8_t)(LINKED_CACHE_FORMAT >> (8 * i)));
+        for(int i = 0; SolveSpaceUI::SAVED[i].type != 0; i++) {
+            const SolveSpaceUI::SaveTable *st = &SolveSpaceUI::SAVED[i];
+            if(st->type != 'e' && st->type != 's') continue;
+            hashByte((uint8_t)st->type);
+            hashByte((uint8_t)st->fmt);
+            for(const char *c = st->desc; *c; c++) hashByte((uint8_t)*c);
+            hashByte(0);
+        }
+        return h;
+    }();
+    return version;
+}
+
+namespace SolveSpace {
+
+class CacheWriter {
+public:
+    std::string data;
+
+    template<class T>
+    void Put(const T &value) { data.append((const char *)&value, sizeof(T)); }
+
+    void PutString(const std::string &str) {
+        Put((uint32_t)str.size());
+        data.append(str);
+    }
+    void PutVector(const Vector &v) { Put(v.x); Put(v.y); Put(v.z); }
+};
+
+class CacheReader {
+public:
+    const char *pos, *end;
+    bool        ok;
+
+    CacheReader(const char *pos, const char *end) : pos(pos), end(end), ok(true) {}
+
+    template<class T>
+    T Get() {
+        T value = {};
+        if(ok && (size_t)(end - pos) >= sizeof(T)) {
+            memcpy(&value, pos, sizeof(T));
+            pos += sizeof(T);
+        } else {
+            ok = false;
+        }
+        return value;
+    }
+
+    std::string GetString() {
+        uint32_t size = Get<uint32_t>();
+        if(!ok || (size_t)(end - pos) < size) {
+            ok = false;
+            return "";
+        }
+        std::string str(pos, pos + size);
+        pos += size;
+        return str;
+    }
+    Vector GetVector() {
+        Vector v;
+        v.x = Get<double>();
+        v.y = Get<double>();
+        v.z = Get<double>();
+        return v;
+    }
+};
+
+}
+
+// The entities and styles are written field by field, from the same table
+// that we use for our text format.
+static void PutSavedFields(CacheWriter *w, int type, const Platform::Path &filename,
+                           SolveSpaceUI::SaveData *data) {
+    for(int i = 0; SolveSpaceUI::SAVED[i].type != 0; i++) {
+        const SolveSpaceUI::SaveTable *st = &SolveSpaceUI::SAVED[i];
+        if(st->type != type) continue;
+
+        SAVEDptr *p = SavedField(st, data);
+        switch(st->fmt) {
+            case 'S': w->PutString(p->S());                     break;
+            case 'b': w->Put((uint8_t)(p->b() ? 1 : 0));        break;
+            case 'c': w->Put(p->c().ToPackedInt());             break;
+            case 'd': w->Put((int32_t)p->d());                  break;
+            case 'f': w->Put(p->f());                           break;
+            case 'x': w->Put(p->x());                           break;
+
+            case 'P': {
+                // Relative to the linked file if possible, like in the file
+                // itself, so that the two can be moved together.
+                Platform::Path relativePath;
+                if(!p->P().IsEmpty()) {
+                    relativePath = p->P().RelativeTo(filename.Parent());
+                }
+                if(p->P().IsEmpty()) {
+                    w->Put((uint8_t)0);
+                } else if(!relativePath.IsEmpty()) {
+                    w->Put((uint8_t)1);
+                    w->PutString(relativePath.ToPortable());
+                } else {
+                    w->Put((uint8_t)2);
+                    w->PutString(p->P().raw);
+                }
+                break;
+            }
+
+            case 'M':
+            case 'i': break;
+
+            default: ssassert(false, "Unexpected value format");
+        }
+    }
+}
+
+static void GetSavedFields(CacheReader *r, int type, const Platform::Path &filename,
+                           SolveSpaceUI::SaveData *data) {
+    for(int i = 0; SolveSpaceUI::SAVED[i].type != 0; i++) {
+        const SolveSpaceUI::SaveTable *st = &SolveSpaceUI::SAVED[i];
+        if(st->type != type) continue;
+
+        SAVEDptr *p = SavedField(st, data);
+        switch(st->fmt) {
+            case 'S': p->S() = r->GetString();                                  break;
+            case 'b': p->b() = (r->Get<uint8_t>() != 0);                        break;
+            case 'c': p->c() = RgbaColor::FromPackedInt(r->Get<uint32_t>());    break;
+            case 'd': p->d() = r->Get<int32_t>();                               break;
+            case 'f': p->f() = r->Get<double>();                                break;
+            case 'x': p->x() = r->Get<uint32_t>();                              break;
+
+            case 'P': {
+                uint8_t kind = r->Get<uint8_t>();
+                if(kind == 1) {
+                    Platform::Path path = Platform::Path::FromPortable(r->GetString());
+                    p->P() = filename.Parent().Join(path).Expand();
+                } else if(kind == 2) {
+                    p->P() = Platform::Path::From(r->GetString());
+                } else if(kind != 0) {
+                    r->ok = false;
+                }
+                break;
+            }
+
+            case 'M':
+            case 'i': break;
+
+            default: ssassert(false, "Unexpected value format");
+        }
+    }
+}
+
+void SolveSpaceUI::SaveLinkedCache(const Platform::Path &filename,
+                                   const Platform::MappedFile &source,
+                                   LinkedSketch *ls)
+{
+    EntityList *le = &ls->entity;
+    SMesh *m = &ls->mesh;
+    SShell *sh = &ls->shell;
+    SaveData sv = {};
+
+    CacheWriter w;
+    w.data.append(LINKED_CACHE_MAGIC, sizeof(LINKED_CACHE_MAGIC));
+    w.Put(LinkedCacheVersion());
+    w.Put(LINKED_CACHE_BYTE_ORDER);
+    w.Put((uint64_t)source.size);
+    w.Put(HashFileContents(source.data, source.size));
+
+    w.Put((uint8_t)(ls->loadError ? 1 : 0));
+    w.Put((uint32_t)le->n);
+    for(Entity &e : *le) {
+        sv.e = e;
+        PutSavedFields(&w, 'e', filename, &sv);
+    }
+
+    w.Put((uint32_t)ls->style.size());
+    for(const Style &s : ls->style) {
+        sv.s = s;
+        PutSavedFields(&w, 's', filename, &sv);
+        w.Put((int32_t)s.zIndex);
+    }
+
+    w.Put((uint32_t)m->l.n);
+    for(const STriangle &tr : m->l) {
+        w.Put(tr.meta.face);
+        w.Put(tr.meta.color.ToPackedInt());
+        w.PutVector(tr.a);
+        w.PutVector(tr.b);
+        w.PutVector(tr.c);
+    }
+
+    w.Put((uint32_t)sh->surface.n);
+    for(SSurface &srf : sh->surface) {
+        w.Put(srf.h.v);
+        w.Put(srf.color.ToPackedInt());
+        w.Put(srf.face);
+        w.Put((int32_t)srf.degm);
+        w.Put((int32_t)srf.degn);
+        for(int i = 0; i <= srf.degm; i++) {
+            for(int j = 0; j <= srf.degn; j++) {
+                w.PutVector(srf.ctrl[i][j]);
+                w.Put(srf.weight[i][j]);
+            }
+        }
+        w.Put((uint32_t)srf.trim.n);
+        for(const STrimBy &stb : srf.trim) {
+            w.Put(stb.curve.v);
+            w.Put((uint8_t)(stb.backwards ? 1 : 0));
+            w.PutVector(stb.start);
+            w.PutVector(stb.finish);
+        }
+    }
+
+    w.Put((uint32_t)sh->curve.n);
+    for(SCurve &sc : sh->curve) {
+        w.Put(sc.h.v);
+        w.Put((uint8_t)(sc.isExact ? 1 : 0));
+        w.Put((int32_t)sc.exact.deg);
+        w.Put(sc.surfA.v);
+        w.Put(sc.surfB.v);
+        if(sc.isExact) {
+            for(int i = 0; i <= sc.exact.deg; i++) {
+                w.PutVector(sc.exact.ctrl[i]);
+                w.Put(sc.exact.weight[i]);
+            }
+        }
+        w.Put((uint32_t)sc.pts.n);
+        for(const SCurvePt &scpt : sc.pts) {
+            w.Put((uint8_t)(scpt.vertex ? 1 : 0));
+            w.PutVector(scpt.p);
+        }
+    }
+
+    // The cache is only an optimization, so don't complain if we can't write it.
+    // As with our own files, write it to a temporary file first, so that a cache
+    // that's cut short is never read back.
+    Platform::Path cacheFile = LinkedCachePath(filename);
+    Platform::Path tempFile  = Platform::Path::From(cacheFile.raw + ".tmp");
+    if(!Platform::WriteFile(tempFile, w.data) || !RenameFile(tempFile, cacheFile)) {
+        RemoveFile(tempFile);
+        dbp("Cannot write cache for linked file '%s'", filename.raw.c_str());
+    }
+}
+
+bool SolveSpaceUI::LoadLinkedCache(const Platform::Path &filename,
+                                   const Platform::MappedFile &source,
+                                   LinkedSketch *ls)
+{
+    EntityList *le = &ls->entity;
+    SMesh *m = &ls->mesh;
+    SShell *sh = &ls->shell;
+
+    Platform::MappedFile cache;
+    if(!cache.Map(LinkedCachePath(filename))) return false;
+
+    CacheReader r(cache.data, cache.data + cache.size);
+    if(cache.size < sizeof(LINKED_CACHE_MAGIC) ||
+       memcmp(cache.data, LINKED_CACHE_MAGIC, sizeof(LINKED_CACHE_MAGIC)) != 0) {
+        return false;
+    }
+    r.pos += sizeof(LINKED_CACHE_MAGIC);
+    if(r.Get<uint32_t>() != LinkedCacheVersion() ||
+       r.Get<uint32_t>() != LINKED_CACHE_BYTE_ORDER ||
+       r.Get<uint64_t>() != (uint64_t)source.size ||
+       r.Get<uint64_t>() != HashFileContents(source.data, source.size)) {
+        return false;
+    }
+
+    SaveData sv = {};
+    ls->loadError = (r.Get<uint8_t>() != 0);
+    uint32_t entityCount = r.Get<uint32_t>();
+    for(uint32_t i = 0; i < entityCount && r.ok; i++) {
+        sv.e = {};
+        GetSavedFields(&r, 'e', filename, &sv);
+        le->Add(&(sv.e));
+    }
+
+    uint32_t styleCount = r.Get<uint32_t>();
+    for(uint32_t i = 0; i < styleCount && r.ok; i++) {
+        sv.s = {};
+        GetSavedFields(&r, 's', filename, &sv);
+        sv.s.zIndex = r.Get<int32_t>();
+        ls->style.push_back(sv.s);
+    }
+
+    uint32_t triangleCount = r.Get<uint32_t>();
+    for(uint32_t i = 0; i < triangleCount && r.ok; i++) {
+        STriangle tr = {};
+        tr.meta.face  = r.Get<uint32_t>();
+        tr.meta.color = RgbaColor::FromPackedInt(r.Get<uint32_t>());
+        tr.a = r.GetVector();
+        tr.b = r.GetVector();
+        tr.c = r.GetVector();
+        m->AddTriangle(&tr);
+    }
+
+    uint32_t surfaceCount = r.Get<uint32_t>();
+    for(uint32_t k = 0; k < surfaceCount && r.ok; k++) {
+        SSurface srf = {};
+        srf.h.v   = r.Get<uint32_t>();
+        srf.color = RgbaColor::FromPackedInt(r.Get<uint32_t>());
+        srf.face  = r.Get<uint32_t>();
+        srf.degm  = r.Get<int32_t>();
+        srf.degn  = r.Get<int32_t>();
+        if(srf.degm < 0 || srf.degm > 3 || srf.degn < 0 || srf.degn > 3) {
+            r.ok = false;
+            break;
+        }
+        for(int i = 0; i <= srf.degm; i++) {
+            for(int j = 0; j <= srf.degn; j++) {
+                srf.ctrl[i][j]   = r.GetVector();
+                srf.weight[i][j] = r.Get<double>();
+            }
+        }
+        uint32_t trimCount = r.Get<uint32_t>();
+        for(uint32_t i = 0; i < trimCount && r.ok; i++) {
+            STrimBy stb = {};
+            stb.curve.v   = r.Get<uint32_t>();
+            stb.backwards = (r.Get<uint8_t>() != 0);
+            stb.start     = r.GetVector();
+            stb.finish    = r.GetVector();
+            srf.trim.Add(&stb);
+        }
+        sh->surface.Add(&srf);
+    }
+
+    uint32_t curveCount = r.Get<uint32_t>();
+    for(uint32_t k = 0; k < curveCount && r.ok; k++) {
+        SCurve crv = {};
+        crv.h.v       = r.Get<uint32_t>();
+        crv.isExact   = (r.Get<uint8_t>() != 0);
+        crv.exact.deg = r.Get<int32_t>();
+        crv.surfA.v   = r.Get<uint32_t>();
+        crv.surfB.v   = r.Get<uint32_t>();
+        if(crv.exact.deg < 0 || crv.exact.deg > 3) {
+            r.ok = false;
+            break;
+        }
+        if(crv.isExact) {
+            for(int i = 0; i <= crv.exact.deg; i++) {
+                crv.exact.ctrl[i]   = r.GetVector();
+                crv.exact.weight[i] = r.Get<double>();
+            }
+        }
+        uint32_t ptCount = r.Get<uint32_t>();
+        for(uint32_t i = 0; i < ptCount && r.ok; i++) {
+            SCurvePt scpt = {};
+            scpt.vertex = (r.Get<uint8_t>() != 0);
+            scpt.p      = r.GetVector();
+            crv.pts.Add(&scpt);
+        }
+        sh->curve.Add(&crv);
+    }
+
+    if(!r.ok || r.pos != r.end) {
+        // Truncated or otherwise damaged; forget whatever we got from it.
+        dbp("Ignoring bad cache for linked file '%s'", filename.raw.c_str());
+        le->Clear();
+        m->Clear();
+        sh->Clear();
+        ls->style.clear();
+        ls->loadError = false;
+        return false;
+    }
     return true;
 }
 
@@ -879,6 +1802,127 @@ static Platform::MessageDialog::Response LocateImportedFile(const Platform::Path
     return dialog->RunModal();
 }
 
+//-----------------------------------------------------------------------------
+// Load a linked file, or share the copy that we already have in memory if the
+// file hasn't changed since we read it. The copies are only kept alive by the
+// groups that use them, so that a file linked forty times is read once, and
+// held in memory once. Linked sketches (but not IDF files, which depend on the
+// chord tolerance) may be loaded from several threads at once.
+//-----------------------------------------------------------------------------
+static std::map<Platform::Path, std::weak_ptr<LinkedSketch>,
+                Platform::PathLess> LinkedSketches;
+
+static std::mutex LinkedSketchesMutex;
+
+// The copy of a file that we already have in memory, if any, and if the file
+// is still the same size and hash.
+static std::shared_ptr<LinkedSketch> FindLinkedSketch(const Platform::Path &filename,
+                                                      uint64_t size, uint64_t *hash) {
+    std::lock_guard<std::mutex> lock(LinkedSketchesMutex);
+    for(auto it = LinkedSketches.begin(); it != LinkedSketches.end();) {
+        if(it->second.expired()) {
+            it = LinkedSketches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    auto it = LinkedSketches.find(filename);
+    if(it == LinkedSketches.end()) return nullptr;
+    std::shared_ptr<LinkedSketch> ls = it->second.lock();
+    if(!ls || ls->size != size || (hash != NULL && ls->hash != *hash)) return nullptr;
+    return ls;
+}
+
+std::shared_ptr<LinkedSketch> SolveSpaceUI::LoadLinkedSketch(const Platform::Path &filename) {
+    // If neither the size nor the modification time changed, don't even read
+    // the file to hash it.
+    uint64_t size;
+    int64_t mtime;
+    if(Platform::StatFile(filename, &size, &mtime)) {
+        std::shared_ptr<LinkedSketch> ls = FindLinkedSketch(filename, size, NULL);
+        if(ls && ls->mtime == mtime) return ls;
+    }
+
+    Platform::MappedFile file;
+    if(!file.Map(filename)) return nullptr;
+    size = file.size;
+    uint64_t hash = HashFileContents(file.data, file.size);
+    file.Unmap();
+
+    std::shared_ptr<LinkedSketch> ls = FindLinkedSketch(filename, size, &hash);
+    if(ls) return ls;
+
+    ls = std::make_shared<LinkedSketch>();
+    ls->filename = filename;
+    ls->size     = size;
+    ls->mtime    = mtime;
+    ls->hash     = hash;
+    if(!LoadEntitiesFromFile(filename, ls.get())) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(LinkedSketchesMutex);
+    LinkedSketches[filename] = ls;
+    return ls;
+}
+
+// Whether the file has been changed since we read it, judging by its size and
+// modification time; much cheaper than reading it again to compare.
+bool LinkedSketch::ChangedOnDisk() const {
+    uint64_t size;
+    int64_t mtime;
+    if(!Platform::StatFile(filename, &size, &mtime)) return true;
+    return size != this->size || mtime != this->mtime;
+}
+
+// After an undo or a redo, share each linked file with the state that was
+// restored, unless it changed on disk since; then read it again. Missing files
+// are left missing, without asking where they went. Returns whether the
+// group's file changed.
+bool SolveSpaceUI::ReloadChangedLinked(Group *g) {
+    if(g->impLinked && !g->impLinked->ChangedOnDisk()) return false;
+
+    std::shared_ptr<LinkedSketch> ls = LoadLinkedSketch(g->linkFile);
+    if(ls == g->impLinked) return false;
+    g->impLinked = ls;
+    if(ls) {
+        if(ls->loadError) fileLoadError = true;
+        for(Style &s : ls->style) {
+            if(SK.style.FindByIdNoOops(s.h) == nullptr) {
+                SK.style.Add(&s);
+            }
+        }
+        for(Entity &e : ls->entity) {
+            if(e.type != Entity::Type::IMAGE || e.file.IsEmpty()) continue;
+            if(images.count(e.file) == 0) images[e.file] = Pixmap::ReadPng(e.file);
+        }
+    }
+    return true;
+}
+
+// A copy of a linked sketch that's ours alone, and so may be changed without
+// affecting the other groups that share the original; it isn't remembered in
+// LinkedSketches, since it no longer matches the file.
+static std::shared_ptr<LinkedSketch> CopyLinkedSketch(LinkedSketch *ls) {
+    std::shared_ptr<LinkedSketch> copy = std::make_shared<LinkedSketch>();
+    copy->filename  = ls->filename;
+    copy->size      = ls->size;
+    copy->mtime     = ls->mtime;
+    copy->hash      = ls->hash;
+    copy->style     = ls->style;
+    copy->loadError = ls->loadError;
+    copy->entity.ReserveMore(ls->entity.n);
+    for(Entity &e : ls->entity) {
+        Entity en = e;
+        en.beziers = {};
+        en.edges   = {};
+        copy->entity.Add(&en);
+    }
+    copy->mesh.MakeFromCopyOf(&ls->mesh);
+    copy->shell.MakeFromCopyOf(&ls->shell);
+    return copy;
+}
+
 bool SolveSpaceUI::ReloadAllLinked(const Platform::Path &saveFile, bool canCancel) {
     Platform::SettingsRef settings = Platform::GetSettings();
 
@@ -886,12 +1930,62 @@ bool SolveSpaceUI::ReloadAllLinked(const Platform::Path &saveFile, bool canCance
 
     allConsistent = false;
 
+    // Read every linked sketch that we can find at once, one per thread. Any
+    // that are missing are dealt with a group at a time below, since that may
+    // mean asking the user where they went.
+    // Keep hold of the sketches that we had until we're done, so that any whose
+    // file is unchanged are found by LoadLinkedSketch() and shared again, and
+    // not freed and read a second time.
+    std::vector<std::shared_ptr<LinkedSketch>> previous;
+    std::vector<Platform::Path> linkFiles;
+    std::set<Platform::Path, Platform::PathLess> seen;
     for(Group &g : SK.group) {
         if(g.type != Group::Type::LINKED) continue;
+        if(g.impLinked) previous.push_back(g.impLinked);
+        g.impLinked = nullptr;
+
+        if(strcmp(g.linkFile.Extension().c_str(), "emn") == 0) continue;
+        if(!seen.insert(g.linkFile).second) continue;
+        linkFiles.push_back(g.linkFile);
+    }
+    std::vector<std::shared_ptr<LinkedSketch>> linkedSketches(linkFiles.size());
+    ParallelFor(linkFiles.size(), [&](size_t i) {
+        linkedSketches[i] = LoadLinkedSketch(linkFiles[i]);
+    });
+
+    std::map<Platform::Path, std::shared_ptr<LinkedSketch>, Platform::PathLess> loaded;
+    for(size_t i = 0; i < linkFiles.size(); i++) {
+        loaded[linkFiles[i]] = linkedSketches[i];
+    }
+
+    // Likewise for the images that those sketches and ours use; any that are
+    // missing are left to ReloadLinkedImage().
+    std::vector<Platform::Path> imageFiles;
+    seen.clear();
+    auto addImage = [&](const Platform::Path &file) {
+        if(file.IsEmpty() || images.count(file)) return;
+        if(!seen.insert(file).second) return;
+        imageFiles.push_back(file);
+    };
+    for(const std::shared_ptr<LinkedSketch> &ls : linkedSketches) {
+        if(!ls) continue;
+        for(Entity &e : ls->entity) {
+            if(e.type == Entity::Type::IMAGE) addImage(e.file);
+        }
+    }
+    for(Request &r : SK.request) {
+        if(r.type == Request::Type::IMAGE) addImage(r.file);
+    }
+    std::vector<std::shared_ptr<Pixmap>> pixmaps(imageFiles.size());
+    ParallelFor(imageFiles.size(), [&](size_t i) {
+        pixmaps[i] = Pixmap::ReadPng(imageFiles[i]);
+    });
+    for(size_t i = 0; i < imageFiles.size(); i++) {
+        if(pixmaps[i]) images[imageFiles[i]] = pixmaps[i];
+    }
 
-        g.impEntity.Clear();
-        g.impMesh.Clear();
-        g.impShell.Clear();
+    for(Group &g : SK.group) {
+        if(g.type != Group::Type::LINKED) continue;
 
         // If we prompted for this specific file before, don't ask again.
         if(linkMap.count(g.linkFile)) {
@@ -899,9 +1993,34 @@ bool SolveSpaceUI::ReloadAllLinked(const Platform::Path &saveFile, bool canCance
         }
 
 try_again:
-        if(LoadEntitiesFromFile(g.linkFile, &g.impEntity, &g.impMesh, &g.impShell)) {
+        if(loaded.count(g.linkFile)) {
+            g.impLinked = loaded[g.linkFile];
+        } else {
+            g.impLinked = LoadLinkedSketch(g.linkFile);
+            loaded[g.linkFile] = g.impLinked;
+        }
+        if(g.impLinked) {
+            if(g.impLinked->loadError) fileLoadError = true;
             // We loaded the data, good. Now import its dependencies as well.
-            for(Entity &e : g.impEntity) {
+            for(Style &s : g.impLinked->style) {
+                // Linked file contains a style that we don't have yet,
+                // so import it.
+                if(SK.style.FindByIdNoOops(s.h) == nullptr) {
+                    SK.style.Add(&s);
+                }
+            }
+            // Relocating a missing image changes the sketch, so do that to a
+            // copy, which the other groups that link this file then share.
+            bool imageMissing = false;
+            for(Entity &e : g.impLinked->entity) {
+                if(e.type != Entity::Type::IMAGE) continue;
+                if(e.file.IsEmpty() || images.count(e.file) == 0) imageMissing = true;
+            }
+            if(imageMissing) {
+                g.impLinked = CopyLinkedSketch(g.impLinked.get());
+                loaded[g.linkFile] = g.impLinked;
+            }
+            for(Entity &e : g.impLinked->entity) {
                 if(e.type != Entity::Type::IMAGE) continue;
                 if(!ReloadLinkedImage(g.linkFile, &e.file, canCancel)) {
                     return false;
@@ -128,11 +128,194 @@ bool SolveSpaceUI::PruneConstraints(hGroup hg) {
     return false;
 }
 
+//-----------------------------------------------------------------------------
+// The largest dimension of the bounding box of all entities, which is what a
+// relative chord tolerance is relative to. The extent that we last used may
+// be off by this fraction before we regenerate to account for it.
+//-----------------------------------------------------------------------------
+const double SolveSpaceUI::CHORD_TOL_EXTENT_SLACK = 0.1;
+
+static double EntityExtent() {
+    BBox box = SK.CalculateEntityBBox(/*includeInvisibles=*/true);
+    Vector size = box.maxp.Minus(box.minp);
+    return std::max({ size.x, size.y, size.z });
+}
+
+//-----------------------------------------------------------------------------
+// A hash of everything that a group's solution, loops and meshes depend on:
+// the group itself, its requests, constraints and params, the linked file if
+// any, the tolerance that we meshed to, and (by chaining them in order) all
+// of the groups before it.
+//-----------------------------------------------------------------------------
+static uint64_t MixHash(uint64_t h, uint64_t v) {
+    h = (h ^ v) * 0x100000001b3ull;
+    return h ^ (h >> 29);
+}
+
+void SolveSpaceUI::FingerprintGroups(std::map<uint32_t, uint64_t> *fingerprints) {
+    std::map<uint32_t, uint64_t> own;
+    for(Group &g : SK.group) {
+        uint64_t h = HashSavedFields('g', &g, 0xcbf29ce484222325ull);
+        if(g.impLinked) h = MixHash(h, g.impLinked->hash);
+        own[g.h.v] = h;
+    }
+    for(Request &r : SK.request) {
+        auto it = own.find(r.group.v);
+        if(it != own.end()) it->second = HashSavedFields('r', &r, it->second);
+    }
+    std::map<uint32_t, uint32_t> valueOf;
+    for(Constraint &c : SK.constraint) {
+        auto it = own.find(c.group.v);
+        if(it != own.end()) it->second = HashSavedFields('c', &c, it->second);
+        if(c.valP.v) valueOf[c.valP.v] = c.group.v;
+    }
+    for(Param &p : SK.param) {
+        // A param belongs to the group of its request, to its own group, or
+        // to the group of the constraint that it's the value of.
+        uint32_t group = 0;
+        if((p.h.v & 0xc0000000) == 0) {
+            Request *r = SK.request.FindByIdNoOops(p.h.request());
+            if(r != NULL) group = r->group.v;
+        } else if(p.h.v & 0x80000000) {
+            group = (p.h.v & 0x7fffffff) >> 16;
+        } else if(valueOf.count(p.h.v)) {
+            group = valueOf[p.h.v];
+        }
+        auto it = own.find(group);
+        if(it != own.end()) it->second = HashSavedFields('p', &p, it->second);
+    }
+
+    // The tolerances that we actually mesh at, which are different for export.
+    double chordTol = ChordTolMm();
+    uint64_t chordTolBits;
+    memcpy(&chordTolBits, &chordTol, sizeof(chordTolBits));
+    uint64_t h = MixHash(chordTolBits, (uint64_t)GetMaxSegments());
+    h = MixHash(h, exportMode ? 1 : 0);
+    for(hGroup hg : SK.groupOrder) {
+        h = MixHash(h, own[hg.v]);
+        (*fingerprints)[hg.v] = h;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// What we generated for a group, kept after the group moved on (because it was
+// edited, or replaced by an undo) in case the sketch comes back to where it
+// was. Only a few are kept, and the oldest are freed first.
+//-----------------------------------------------------------------------------
+namespace {
+struct GroupGeometry {
+    uint64_t                    fingerprint;
+    decltype(Group::solved)     solved;
+    SPolygon                    polyLoops;
+    SBezierLoopSetSet           bezierLoops;
+    SBezierLoopSet              bezierOpens;
+    decltype(Group::polyError)  polyError;
+    bool                        booleanFailed;
+    SShell                      thisShell;
+    SShell                      runningShell;
+    SMesh                       thisMesh;
+    SMesh                       runningMesh;
+
+    void Clear() {
+        solved.remove.Clear();
+        polyLoops.Clear();
+        bezierLoops.Clear();
+        bezierOpens.Clear();
+        thisShell.Clear();
+        runningShell.Clear();
+        thisMesh.Clear();
+        runningMesh.Clear();
+    }
+};
+}
+
+static const size_t MAX_CACHED_GEOMETRY = 16;
+static std::vector<GroupGeometry> CachedGeometry;
+
+void SolveSpaceUI::StashGroupGeometry(Group *g) {
+    if(g->fingerprint == 0) return;
+    for(const GroupGeometry &gg : CachedGeometry) {
+        if(gg.fingerprint == g->fingerprint) return;
+    }
+
+    if(CachedGeometry.size() >= MAX_CACHED_GEOMETRY) {
+        CachedGeometry.front().Clear();
+        CachedGeometry.erase(CachedGeometry.begin());
+    }
+
+    // The lists now belong to the cache.
+    GroupGeometry gg = {};
+    gg.fingerprint   = g->fingerprint;
+    gg.solved        = g->solved;
+    gg.polyLoops     = g->polyLoops;
+    gg.bezierLoops   = g->bezierLoops;
+    gg.bezierOpens   = g->bezierOpens;
+    gg.polyError     = g->polyError;
+    gg.booleanFailed = g->booleanFailed;
+    gg.thisShell     = g->thisShell;
+    gg.runningShell  = g->runningShell;
+    gg.thisMesh      = g->thisMesh;
+    gg.runningMesh   = g->runningMesh;
+    CachedGeometry.push_back(gg);
+
+    g->solved.remove = {};
+    g->polyLoops     = {};
+    g->bezierLoops   = {};
+    g->bezierOpens   = {};
+    g->thisShell     = {};
+    g->runningShell  = {};
+    g->thisMesh      = {};
+    g->runningMesh   = {};
+    g->fingerprint   = 0;
+}
+
+bool SolveSpaceUI::RestoreGroupGeometry(Group *g, uint64_t fingerprint) {
+    auto it = std::find_if(CachedGeometry.begin(), CachedGeometry.end(),
+        [&](const GroupGeometry &gg) { return gg.fingerprint == fingerprint; });
+    if(it == CachedGeometry.end()) return false;
+
+    g->solved.remove.Clear();
+    g->polyLoops.Clear();
+    g->bezierLoops.Clear();
+    g->bezierOpens.Clear();
+    g->thisShell.Clear();
+    g->runningShell.Clear();
+    g->thisMesh.Clear();
+    g->runningMesh.Clear();
+
+    g->solved        = it->solved;
+    g->polyLoops     = it->polyLoops;
+    g->bezierLoops   = it->bezierLoops;
+    g->bezierOpens   = it->bezierOpens;
+    g->polyError     = it->polyError;
+    g->booleanFailed = it->booleanFailed;
+    g->thisShell     = it->thisShell;
+    g->runningShell  = it->runningShell;
+    g->thisMesh      = it->thisMesh;
+    g->runningMesh   = it->runningMesh;
+    g->fingerprint   = fingerprint;
+    g->displayDirty  = true;
+    CachedGeometry.erase(it);
+    return true;
+}
+
+size_t SolveSpaceUI::StashedGroupGeometryCount() {
+    return CachedGeometry.size();
+}
+
+void SolveSpaceUI::ClearGroupGeometry() {
+    for(GroupGeometry &gg : CachedGeometry) {
+        gg.Clear();
+    }
+    CachedGeometry.clear();
+}
+
 void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox) {
     int first = 0, last = 0, i;
 
     uint64_t startMillis = GetMilliseconds(),
              endMillis;
+    ProfileScope profile(hGroup(), Profile::Phase::GENERATE_ALL);
 
     SK.groupOrder.Clear();
     for(auto &g : SK.group) { SK.groupOrder.Add(&g.h); }
@@ -190,14 +373,19 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
         }
     }
 
-    // If we're generating entities for display, first we need to find
-    // the bounding box to turn relative chord tolerance to absolute.
+    // If we're generating entities for display, we need the bounding box to
+    // turn relative chord tolerance to absolute. Assume that the model is
+    // about as big as it was last time, and check once we've solved; only if
+    // we know nothing about its size do we need a separate pass, solving
+    // everything just to find the bounding box.
+    bool solvedForBBox = false;
     if(!SS.exportMode && !genForBBox) {
-        GenerateAll(type, andFindFree, /*genForBBox=*/true);
-        BBox box = SK.CalculateEntityBBox(/*includeInvisibles=*/true);
-        Vector size = box.maxp.Minus(box.minp);
-        double maxSize = std::max({ size.x, size.y, size.z });
-        chordTolCalculated = maxSize * chordTol / 100.0;
+        if(chordTolExtent <= 0.0) {
+            GenerateAll(type, andFindFree, /*genForBBox=*/true);
+            chordTolExtent = EntityExtent();
+            solvedForBBox = true;
+        }
+        chordTolCalculated = chordTolExtent * chordTol / 100.0;
     }
 
     // Remove any requests or constraints that refer to a nonexistent
@@ -214,6 +402,10 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
     SK.entity.Clear();
     SK.entity.ReserveMore(oldEntityCount);
 
+    // Whether a group in range so far has changed; an export pass solves that
+    // group and everything after it, just like any other regeneration.
+    bool changed = false;
+
     // Not using range-for because we're using the index inside the loop.
     for(i = 0; i < SK.groupOrder.n; i++) {
         hGroup hg = SK.groupOrder[i];
@@ -224,19 +416,27 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
         if(PruneGroups(hg))
             goto pruned;
 
-        for(auto &req : SK.request) {
-            Request *r = &req;
-            if(r->group != hg) continue;
-
-            r->Generate(&(SK.entity), &(SK.param));
+        Profile::currentGroup = hg;
+        if(Profile::enabled) {
+            Profile::NameGroup(hg, SK.GetGroup(hg)->DescriptionString());
         }
-        for(auto &con : SK.constraint) {
-            Constraint *c = &con;
-            if(c->group != hg) continue;
 
-            c->Generate(&(SK.param));
+        {
+            ProfileScope profile(hg, Profile::Phase::ENTITIES);
+            for(auto &req : SK.request) {
+                Request *r = &req;
+                if(r->group != hg) continue;
+
+                r->Generate(&(SK.entity), &(SK.param));
+            }
+            for(auto &con : SK.constraint) {
+                Constraint *c = &con;
+                if(c->group != hg) continue;
+
+                c->Generate(&(SK.param));
+            }
+            SK.GetGroup(hg)->Generate(&(SK.entity), &(SK.param));
         }
-        SK.GetGroup(hg)->Generate(&(SK.entity), &(SK.param));
 
         // The requests and constraints depend on stuff in this or the
         // previous group, so check them after generating.
@@ -267,10 +467,22 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
                 // The group falls inside the range, so really solve it,
                 // and then regenerate the mesh based on the solved stuff.
                 Group *g = SK.GetGroup(hg);
-                if(genForBBox) {
+                if(!g->clean) changed = true;
+                // An export pass only needs to mesh again what hasn't changed,
+                // at its own tolerance; the solution and loops are as they were.
+                bool solve = genForBBox || (!solvedForBBox && (!SS.exportMode || changed));
+                if(solve && !genForBBox && UndoMayRestore(g->fingerprint)) {
+                    // Keep what we had, if an undo could bring it back; only
+                    // when the loops will be made again, or they'd be lost.
+                    // While dragging, that's just before the first step.
+                    StashGroupGeometry(g);
+                }
+                if(solve) {
+                    ProfileScope profile(hg, Profile::Phase::SOLVE);
                     SolveGroupAndReport(hg, andFindFree);
                     g->GenerateLoops();
-                } else {
+                }
+                if(!genForBBox) {
                     g->GenerateShellAndMesh();
                     g->clean = true;
                 }
@@ -288,6 +500,26 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
         }
     }
 
+    // If the model turned out to be a different size from what we assumed,
+    // then the loops and meshes that we just made are too coarse or too
+    // fine; so make them again, though there's no need to solve again.
+    if(!SS.exportMode && !genForBBox && !solvedForBBox) {
+        double extent = EntityExtent();
+        if(fabs(extent - chordTolExtent) > CHORD_TOL_EXTENT_SLACK * chordTolExtent) {
+            chordTolExtent = extent;
+            chordTolCalculated = chordTolExtent * chordTol / 100.0;
+
+            for(i = max(first, 0); i <= last && i < SK.groupOrder.n; i++) {
+                hGroup hg = SK.groupOrder[i];
+                if(hg == Group::HGROUP_REFERENCES) continue;
+
+                Group *g = SK.GetGroup(hg);
+                g->GenerateLoops();
+                g->GenerateShellAndMesh();
+            }
+        }
+    }
+
     // And update any reference dimensions with their new values
     for(auto &con : SK.constraint) {
         Constraint *c = &con;
@@ -296,6 +528,15 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
         }
     }
 
+    // Now record what each group that's up to date was generated from.
+    if(!genForBBox) {
+        std::map<uint32_t, uint64_t> fingerprints;
+        FingerprintGroups(&fingerprints);
+        for(Group &g : SK.group) {
+            if(g.clean) g.fingerprint = fingerprints[g.h.v];
+        }
+    }
+
     // Make sure the point that we're tracing exists.
     if(traced.point.v && !SK.entity.FindByIdNoOops(traced.point)) {
         traced.point = Entity::NO_ENTITY;
@@ -499,6 +740,8 @@ void SolveSpaceUI::SolveGroupAndReport(hGroup hg, bool andFindFree) {
 }
 
 void SolveSpaceUI::WriteEqSystemForGroup(hGroup hg) {
+    Profile::currentGroup = hg;
+
     // Clear out the system to be solved.
     sys.entity.Clear();
     sys.param.Clear();
@@ -544,6 +787,7 @@ void SolveSpaceUI::SolveGroup(hGroup hg, bool andFindFree) {
         g->dofCheckOk = true;
     }
     g->solved.how = how;
+    g->solved.stats = sys.stats;
     FreeAllTemporary();
 }
 
@@ -27,9 +27,7 @@ void Group::Clear() {
     runningShell.Clear();
     displayMesh.Clear();
     displayOutlines.Clear();
-    impMesh.Clear();
-    impShell.Clear();
-    impEntity.Clear();
+    impLinked = nullptr;
     // remap is the only one that doesn't get recreated when we regen
     remap.clear();
 }
@@ -763,13 +761,13 @@ void Group::Generate(IdList<Entity,hEntity> *entity,
             AddParam(param, h.param(5), 0);
             AddParam(param, h.param(6), 0);
 
-            // Not using range-for here because we're changing the size of entity in the loop.
-            for(i = 0; i < impEntity.n; i++) {
-                Entity *ie = &(impEntity[i]);
-                CopyEntity(entity, ie, 0, 0,
-                    h.param(0), h.param(1), h.param(2),
-                    h.param(3), h.param(4), h.param(5), h.param(6), NO_PARAM,
-                    CopyAs::N_ROT_TRANS);
+            if(impLinked) {
+                for(Entity &ie : impLinked->entity) {
+                    CopyEntity(entity, &ie, 0, 0,
+                        h.param(0), h.param(1), h.param(2),
+                        h.param(3), h.param(4), h.param(5), h.param(6), NO_PARAM,
+                        CopyAs::N_ROT_TRANS);
+                }
             }
             return;
     }
@@ -178,6 +178,8 @@ void Group::GenerateForStepAndRepeat(T *steps, T *outs, Group::CombineAs forWhat
 
 template<class T>
 void Group::GenerateForBoolean(T *prevs, T *thiss, T *outs, Group::CombineAs how) {
+    ProfileScope profile(h, Profile::Phase::BOOLEAN);
+
     // If this group contributes no new mesh, then our running mesh is the
     // same as last time, no combining required. Likewise if we have a mesh
     // but it's suppressed.
@@ -208,6 +210,8 @@ void Group::GenerateForBoolean(T *prevs, T *thiss, T *outs, Group::CombineAs how
 }
 
 void Group::GenerateShellAndMesh() {
+    ProfileScope profile(h, Profile::Phase::SHELL_AND_MESH);
+
     bool prevBooleanFailed = booleanFailed;
     booleanFailed = false;
 
@@ -382,11 +386,13 @@ void Group::GenerateShellAndMesh() {
             SK.GetParam(h.param(5))->val,
             SK.GetParam(h.param(6))->val };
 
-        thisMesh.MakeFromTransformationOf(&impMesh, offset, q, scale);
-        thisMesh.RemapFaces(this, 0);
+        if(impLinked) {
+            thisMesh.MakeFromTransformationOf(&impLinked->mesh, offset, q, scale);
+            thisMesh.RemapFaces(this, 0);
 
-        thisShell.MakeFromTransformationOf(&impShell, offset, q, scale);
-        thisShell.RemapFaces(this, 0);
+            thisShell.MakeFromTransformationOf(&impLinked->shell, offset, q, scale);
+            thisShell.RemapFaces(this, 0);
+        }
     }
 
     if(srcg->meshCombine != CombineAs::ASSEMBLE) {
@@ -420,10 +426,12 @@ void Group::GenerateShellAndMesh() {
         thism = {};
 
         prevm.MakeFromCopyOf(&(prevg->runningMesh));
-        prevg->runningShell.TriangulateInto(&prevm);
-
         thism.MakeFromCopyOf(&thisMesh);
-        thisShell.TriangulateInto(&thism);
+        {
+            ProfileScope profile(h, Profile::Phase::TRIANGULATE);
+            prevg->runningShell.TriangulateInto(&prevm);
+            thisShell.TriangulateInto(&thism);
+        }
 
         SMesh outm = {};
         GenerateForBoolean<SMesh>(&prevm, &thism, &outm, srcg->meshCombine);
@@ -435,6 +443,7 @@ void Group::GenerateShellAndMesh() {
 
         if(srcg->meshCombine != CombineAs::ASSEMBLE) {
             // And make sure that the output mesh is vertex-to-vertex.
+            Platform::TemporaryScope scope("SKdNode::SnapToMesh");
             SKdNode *root = SKdNode::From(&outm);
             root->SnapToMesh(&outm);
             root->MakeMeshInto(&runningMesh);
@@ -455,6 +464,8 @@ void Group::GenerateDisplayItems() {
     // to find the emphasized edges for a mesh), so we will run it only
     // if its inputs have changed.
     if(displayDirty) {
+        ProfileScope profile(h, Profile::Phase::DISPLAY_ITEMS);
+
         Group *pg = RunningMeshGroup();
         if(pg && thisMesh.IsEmpty() && thisShell.IsEmpty()) {
             // We don't contribute any new solid model in this group, so our
@@ -478,7 +489,10 @@ void Group::GenerateDisplayItems() {
             // We do contribute new solid model, so we have to triangulate the
             // shell, and edge-find the mesh.
             displayMesh.Clear();
-            runningShell.TriangulateInto(&displayMesh);
+            {
+                ProfileScope profile(h, Profile::Phase::TRIANGULATE);
+                runningShell.TriangulateInto(&displayMesh);
+            }
             STriangle *t;
             for(t = runningMesh.l.First(); t; t = runningMesh.l.NextAfter(t)) {
                 STriangle trn = *t;
@@ -8,8 +8,27 @@
 #define EXPORT_DLL
 #include <slvs.h>
 
-Sketch SolveSpace::SK = {};
-static System SYS;
+thread_local Sketch SolveSpace::SK = {};
+
+// Everything needed to solve a system, which is owned by the context and not
+// shared with any other; so each thread may solve in a context of its own.
+// The sketch is swapped into this thread's SK while solving, and keeps its
+// storage from one solve to the next.
+struct Slvs_Context {
+    Sketch                  sketch;
+    std::unique_ptr<System> sys;
+
+    // After a successful solve, the sketch and the system are kept as they
+    // are, along with enough of the caller's system to tell whether the next
+    // one differs only in the values of its params; if so, it's solved with
+    // the kept equations and Jacobians.
+    bool                            prepared;
+    Slvs_hGroup                     group;
+    std::vector<Slvs_Param>         params;
+    std::vector<Slvs_Entity>        entities;
+    std::vector<Slvs_Constraint>    constraints;
+    Slvs_hParam                     dragged[4];
+};
 
 void SolveSpace::Platform::FatalError(const std::string &message) {
     fprintf(stderr, "%s", message.c_str());
@@ -65,7 +84,7 @@ void Slvs_MakeQuaternion(double ux, double uy, double uz,
     *qz = q.vz;
 }
 
-void Slvs_Solve(Slvs_System *ssys, Slvs_hGroup shg)
+static bool LoadSystem(System *sys, Slvs_System *ssys, Slvs_hGroup shg)
 {
     int i;
     for(i = 0; i < ssys->params; i++) {
@@ -76,7 +95,7 @@ void Slvs_Solve(Slvs_System *ssys, Slvs_hGroup shg)
         p.val = sp->val;
         SK.param.Add(&p);
         if(sp->group == shg) {
-            SYS.param.Add(&p);
+            sys->param.Add(&p);
         }
     }
 
@@ -96,7 +115,7 @@ case SLVS_E_CUBIC:              e.type = Entity::Type::CUBIC; break;
 case SLVS_E_CIRCLE:             e.type = Entity::Type::CIRCLE; break;
 case SLVS_E_ARC_OF_CIRCLE:      e.type = Entity::Type::ARC_OF_CIRCLE; break;
 
-default: dbp("bad entity type %d", se->type); return;
+default: dbp("bad entity type %d", se->type); return false;
         }
         e.h.v           = se->h;
         e.group.v       = se->group;
@@ -160,7 +179,7 @@ case SLVS_C_PROJ_PT_DISTANCE:   t = Constraint::Type::PROJ_PT_DISTANCE; break;
 case SLVS_C_WHERE_DRAGGED:      t = Constraint::Type::WHERE_DRAGGED; break;
 case SLVS_C_CURVE_CURVE_TANGENT:t = Constraint::Type::CURVE_CURVE_TANGENT; break;
 
-default: dbp("bad constraint type %d", sc->type); return;
+default: dbp("bad constraint type %d", sc->type); return false;
         }
 
         c.type = t;
@@ -183,7 +202,7 @@ default: dbp("bad constraint type %d", sc->type); return;
             for(Param &p : params) {
                 p.h = SK.param.AddAndAssignId(&p);
                 c.valP = p.h;
-                SYS.param.Add(&p);
+                sys->param.Add(&p);
             }
             params.Clear();
             c.ModifyToSatisfy();
@@ -195,19 +214,15 @@ default: dbp("bad constraint type %d", sc->type); return;
     for(i = 0; i < (int)arraylen(ssys->dragged); i++) {
         if(ssys->dragged[i]) {
             hParam hp = { ssys->dragged[i] };
-            SYS.dragged.Add(&hp);
+            sys->dragged.Add(&hp);
         }
     }
+    return true;
+}
 
-    Group g = {};
-    g.h.v = shg;
-
-    List<hConstraint> bad = {};
-
-    // Now we're finally ready to solve!
-    bool andFindBad = ssys->calculateFaileds ? true : false;
-    SolveResult how = SYS.Solve(&g, NULL, &(ssys->dof), &bad, andFindBad, /*andFindFree=*/false);
-
+static void ReportResult(SolveResult how, List<hConstraint> *bad, Slvs_System *ssys)
+{
+    int i;
     switch(how) {
         case SolveResult::OKAY:
             ssys->result = SLVS_RESULT_OKAY;
@@ -236,23 +251,236 @@ default: dbp("bad constraint type %d", sc->type); return;
 
     if(ssys->failed) {
         // Copy over any the list of problematic constraints.
-        for(i = 0; i < ssys->faileds && i < bad.n; i++) {
-            ssys->failed[i] = bad[i].v;
+        for(i = 0; i < ssys->faileds && i < bad->n; i++) {
+            ssys->failed[i] = (*bad)[i].v;
         }
-        ssys->faileds = bad.n;
+        ssys->faileds = bad->n;
+    }
+}
+
+static bool SameEntity(const Slvs_Entity &a, const Slvs_Entity &b)
+{
+    int i;
+    for(i = 0; i < 4; i++) {
+        if(a.point[i] != b.point[i] || a.param[i] != b.param[i]) return false;
     }
+    return a.h == b.h && a.group == b.group && a.type == b.type &&
+           a.wrkpl == b.wrkpl && a.normal == b.normal && a.distance == b.distance;
+}
 
-    bad.Clear();
-    SYS.param.Clear();
-    SYS.entity.Clear();
-    SYS.eq.Clear();
-    SYS.dragged.Clear();
+static bool SameConstraint(const Slvs_Constraint &a, const Slvs_Constraint &b)
+{
+    return a.h == b.h && a.group == b.group && a.type == b.type &&
+           a.wrkpl == b.wrkpl && a.valA == b.valA &&
+           a.ptA == b.ptA && a.ptB == b.ptB &&
+           a.entityA == b.entityA && a.entityB == b.entityB &&
+           a.entityC == b.entityC && a.entityD == b.entityD &&
+           (a.other != 0) == (b.other != 0) && (a.other2 != 0) == (b.other2 != 0);
+}
+
+// Whether the system differs from the one that the context last solved only
+// in the values of its params, so that its equations are the same.
+static bool SameSystem(const Slvs_Context *ctx, const Slvs_System *ssys, Slvs_hGroup shg)
+{
+    if(!ctx->prepared || shg != ctx->group) return false;
+    if(ssys->params != (int)ctx->params.size() ||
+       ssys->entities != (int)ctx->entities.size() ||
+       ssys->constraints != (int)ctx->constraints.size())
+    {
+        return false;
+    }
+
+    int i;
+    for(i = 0; i < (int)arraylen(ssys->dragged); i++) {
+        if(ssys->dragged[i] != ctx->dragged[i]) return false;
+    }
+    for(i = 0; i < ssys->params; i++) {
+        const Slvs_Param &sp = ssys->param[i];
+        if(sp.h != ctx->params[i].h || sp.group != ctx->params[i].group) return false;
+    }
+    for(i = 0; i < ssys->entities; i++) {
+        if(!SameEntity(ssys->entity[i], ctx->entities[i])) return false;
+    }
+    for(i = 0; i < ssys->constraints; i++) {
+        if(!SameConstraint(ssys->constraint[i], ctx->constraints[i])) return false;
+    }
+    return true;
+}
+
+static void RememberSystem(Slvs_Context *ctx, const Slvs_System *ssys, Slvs_hGroup shg)
+{
+    ctx->group = shg;
+    ctx->params.assign(ssys->param, ssys->param + ssys->params);
+    ctx->entities.assign(ssys->entity, ssys->entity + ssys->entities);
+    ctx->constraints.assign(ssys->constraint, ssys->constraint + ssys->constraints);
+    std::copy(ssys->dragged, ssys->dragged + arraylen(ssys->dragged), ctx->dragged);
+}
+
+static void ForgetSystem(Slvs_Context *ctx)
+{
+    ctx->prepared = false;
+    ctx->sys->Clear();
 
     SK.param.Clear();
     SK.entity.Clear();
     SK.constraint.Clear();
+}
+
+// Take the new values of the caller's params. Any params that the constraints
+// made for themselves start from zero, as they would in a fresh solve.
+static void UpdateParams(System *sys, Slvs_System *ssys, Slvs_hGroup shg)
+{
+    for(Param &p : sys->param) {
+        p.val = 0.0;
+    }
+
+    int i;
+    for(i = 0; i < ssys->params; i++) {
+        Slvs_Param *sp = &(ssys->param[i]);
+        hParam hp = { sp->h };
+        SK.GetParam(hp)->val = sp->val;
+        if(sp->group == shg) {
+            sys->param.FindById(hp)->val = sp->val;
+        }
+    }
+}
+
+Slvs_Context *Slvs_CreateContext(void)
+{
+    Slvs_Context *ctx = new Slvs_Context();
+    ctx->sys.reset(new System());
+    ctx->prepared = false;
+    return ctx;
+}
+
+void Slvs_DestroyContext(Slvs_Context *ctx)
+{
+    delete ctx;
+}
+
+void Slvs_SolveInContext(Slvs_Context *ctx, Slvs_System *ssys, Slvs_hGroup shg)
+{
+    std::swap(SK, ctx->sketch);
+    System *sys = ctx->sys.get();
+
+    Group g = {};
+    g.h.v = shg;
+
+    List<hConstraint> bad = {};
+    bool andFindBad = ssys->calculateFaileds ? true : false;
+
+    SolveResult how;
+    if(SameSystem(ctx, ssys, shg)) {
+        UpdateParams(sys, ssys, shg);
+        how = sys->SolveAgain(&g, NULL, &(ssys->dof), &bad, andFindBad,
+                              /*andFindFree=*/false);
+    } else {
+        ForgetSystem(ctx);
+        if(!LoadSystem(sys, ssys, shg)) {
+            ForgetSystem(ctx);
+            std::swap(SK, ctx->sketch);
+            FreeAllTemporary();
+            return;
+        }
+        RememberSystem(ctx, ssys, shg);
+
+        // Now we're finally ready to solve!
+        sys->keepJacobians = true;
+        how = sys->Solve(&g, NULL, &(ssys->dof), &bad, andFindBad,
+                         /*andFindFree=*/false);
+    }
+    ReportResult(how, &bad, ssys);
+    bad.Clear();
+
+    // Anything but a clean solve may have rewritten the equations while
+    // looking for what's bad, so start over next time.
+    ctx->prepared = (how == SolveResult::OKAY);
+    if(!ctx->prepared) ForgetSystem(ctx);
+    std::swap(SK, ctx->sketch);
 
     FreeAllTemporary();
 }
 
+// The context for each thread that uses Slvs_Solve(), made when first needed.
+static Slvs_Context *ThreadContext()
+{
+    static thread_local std::unique_ptr<Slvs_Context, void (*)(Slvs_Context *)>
+        ctx(NULL, Slvs_DestroyContext);
+    if(!ctx) ctx.reset(Slvs_CreateContext());
+    return ctx.get();
+}
+
+void Slvs_Solve(Slvs_System *ssys, Slvs_hGroup shg)
+{
+    Slvs_SolveInContext(ThreadContext(), ssys, shg);
+}
+
+void Slvs_GetSolveStats(Slvs_Context *ctx, Slvs_SolveStats *sst)
+{
+    if(!ctx) ctx = ThreadContext();
+    const SolveStats &st = ctx->sys->stats;
+
+    sst->equations          = st.equations;
+    sst->unknowns           = st.unknowns;
+    sst->substituted        = st.substituted;
+    sst->alone              = st.alone;
+    sst->iterations         = st.iterations;
+    sst->residual           = st.residual;
+    sst->substitutionTime   = st.substitutionMicros / 1000.0;
+    sst->jacobianTime       = st.jacobianMicros / 1000.0;
+    sst->rankTestTime       = st.rankTestMicros / 1000.0;
+    sst->linearSolveTime    = st.linearSolveMicros / 1000.0;
+    sst->reused             = st.reused ? 1 : 0;
+}
+
+void Slvs_SolveBatch(Slvs_System *ssys, Slvs_hGroup shg, int scenarios,
+                     double *vals, int *results, int *dofs)
+{
+    int params = ssys->params;
+
+    // Each worker solves the next scenario that nobody has taken yet, in a
+    // context of its own, so it writes the equations once and then only
+    // iterates.
+    std::atomic<int> next(0);
+    auto work = [&]() {
+        Slvs_Context *ctx = Slvs_CreateContext();
+        std::vector<Slvs_Param> param(ssys->param, ssys->param + params);
+
+        Slvs_System sys = *ssys;
+        sys.param            = param.data();
+        sys.failed           = NULL;
+        sys.faileds          = 0;
+        sys.calculateFaileds = 0;
+
+        for(int i; (i = next.fetch_add(1)) < scenarios;) {
+            double *val = &vals[(size_t)i * params];
+            int j;
+            for(j = 0; j < params; j++) {
+                param[j].val = val[j];
+            }
+
+            Slvs_SolveInContext(ctx, &sys, shg);
+
+            for(j = 0; j < params; j++) {
+                val[j] = param[j].val;
+            }
+            if(results) results[i] = sys.result;
+            if(dofs)    dofs[i]    = sys.dof;
+        }
+
+        Slvs_DestroyContext(ctx);
+    };
+
+    int workers = (int)std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, scenarios);
+    std::vector<std::thread> threads;
+    for(int i = 1; i < workers; i++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for(std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
 } /* extern "C" */
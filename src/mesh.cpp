@@ -6,8 +6,6 @@
 //-----------------------------------------------------------------------------
 #include "solvespace.h"
 
-#include <set>
-
 void SMesh::Clear() {
     l.Clear();
 }
@@ -91,8 +89,9 @@ void SMesh::MakeEdgesInPlaneInto(SEdgeList *sel, Vector n, double d) {
 }
 
 void SMesh::MakeOutlinesInto(SOutlineList *sol, EdgeKind edgeKind) {
-    SKdNode *root = SKdNode::From(this);
-    root->MakeOutlinesInto(sol, edgeKind);
+    SMeshAdjacency adj = {};
+    adj.Build(this);
+    adj.MakeOutlinesInto(sol, edgeKind);
 }
 
 //-----------------------------------------------------------------------------
@@ -261,6 +260,7 @@ void SMesh::AddAgainstBsp(SMesh *srcm, SBsp3 *bsp3) {
 }
 
 void SMesh::MakeFromUnionOf(SMesh *a, SMesh *b) {
+    Platform::TemporaryScope scope("SMesh::MakeFromUnionOf");
     SBsp3 *bspa = SBsp3::FromMesh(a);
     SBsp3 *bspb = SBsp3::FromMesh(b);
 
@@ -275,6 +275,7 @@ void SMesh::MakeFromUnionOf(SMesh *a, SMesh *b) {
 }
 
 void SMesh::MakeFromDifferenceOf(SMesh *a, SMesh *b) {
+    Platform::TemporaryScope scope("SMesh::MakeFromDifferenceOf");
     SBsp3 *bspa = SBsp3::FromMesh(a);
     SBsp3 *bspb = SBsp3::FromMesh(b);
 
@@ -290,6 +291,7 @@ void SMesh::MakeFromDifferenceOf(SMesh *a, SMesh *b) {
 }
 
 void SMesh::MakeFromIntersectionOf(SMesh *a, SMesh *b) {
+    Platform::TemporaryScope scope("SMesh::MakeFromIntersectionOf");
     SBsp3 *bspa = SBsp3::FromMesh(a);
     SBsp3 *bspb = SBsp3::FromMesh(b);
 
@@ -929,17 +931,6 @@ void SKdNode::FindEdgeOn(Vector a, Vector b, int cnt, bool coplanarIsInter,
     }
 }
 
-static bool CheckAndAddTrianglePair(std::set<std::pair<STriangle *, STriangle *>> *pairs,
-                                    STriangle *a, STriangle *b)
-{
-    if(pairs->find(std::make_pair(a, b)) != pairs->end() ||
-       pairs->find(std::make_pair(b, a)) != pairs->end())
-        return true;
-
-    pairs->emplace(a, b);
-    return false;
-}
-
 //-----------------------------------------------------------------------------
 // Pick certain classes of edges out from our mesh. These might be:
 //    * naked edges (i.e., edges with no anti-parallel neighbor) and self-
@@ -952,149 +943,289 @@ static bool CheckAndAddTrianglePair(std::set<std::pair<STriangle *, STriangle *>
 void SKdNode::MakeCertainEdgesInto(SEdgeList *sel, EdgeKind how, bool coplanarIsInter,
                                    bool *inter, bool *leaky, int auxA) const
 {
-    if(inter) *inter = false;
-    if(leaky) *leaky = false;
-
     std::vector<STriangle *> tris;
     ClearTags();
     ListTrianglesInto(&tris);
 
-    std::set<std::pair<STriangle *, STriangle *>> edgeTris;
-    int cnt = 1234;
-    for(STriangle *tr : tris) {
-        for(int j = 0; j < 3; j++) {
-            Vector a = tr->vertices[j];
-            Vector b = tr->vertices[(j + 1) % 3];
+    SMeshAdjacency adj = {};
+    adj.Build(tris);
+    adj.MakeCertainEdgesInto(sel, how, this, coplanarIsInter, inter, leaky, auxA);
+}
 
-            SKdNode::EdgeOnInfo info = {};
-            FindEdgeOn(a, b, cnt, coplanarIsInter, &info);
-
-            switch(how) {
-                case EdgeKind::NAKED_OR_SELF_INTER:
-                    // there should be one anti-parllel edge
-                    if(info.count != 1) {
-                        // but there may be multiple parallel coincident edges
-                        SKdNode::EdgeOnInfo parallelInfo = {};
-                        FindEdgeOn(b, a, -cnt, coplanarIsInter, &parallelInfo);
-                        if (info.count != parallelInfo.count) {
-                            sel->AddEdge(a, b, auxA);
-                            if(leaky) *leaky = true;
-                        }
-                    }
-                    if(info.intersectsMesh) {
-                        sel->AddEdge(a, b, auxA);
-                        if(inter) *inter = true;
-                    }
-                    break;
+//-----------------------------------------------------------------------------
+// Welding and half-edge adjacency, so that we can find the neighbours of
+// every edge in a single linear pass instead of a kd-tree query per edge.
+//-----------------------------------------------------------------------------
+void SMeshAdjacency::Clear() {
+    vertices.clear();
+    halfEdges.clear();
+    firstEdge.clear();
+    vertexCells.clear();
+}
 
-                case EdgeKind::SELF_INTER:
-                    if(info.intersectsMesh) {
-                        sel->AddEdge(a, b, auxA);
-                        if(inter) *inter = true;
-                    }
-                    break;
+// Vertices are hashed into a grid of cells that are larger than our
+// tolerance, so a vertex can only be Equals() to the vertices in its own
+// cell or in a neighbouring one that lies within LENGTH_EPS.
+static const double ADJ_CELL_SIZE = 4*LENGTH_EPS;
 
-                case EdgeKind::TURNING:
-                    if((tr->Normal().z < LENGTH_EPS) &&
-                       (info.count == 1) &&
-                       info.frontFacing)
-                    {
-                        if(CheckAndAddTrianglePair(&edgeTris, tr, info.tr))
-                            break;
-                        // This triangle is back-facing (or on edge), and
-                        // this edge has exactly one mate, and that mate is
-                        // front-facing. So this is a turning edge.
-                        sel->AddEdge(a, b, auxA);
-                    }
-                    break;
+static uint64_t CellHash(int64_t x, int64_t y, int64_t z) {
+    uint64_t h = (uint64_t)x * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)y * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+    h ^= (uint64_t)z * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+    return h;
+}
 
-                case EdgeKind::EMPHASIZED:
-                    if(info.count == 1 && tr->meta.face != info.tr->meta.face) {
-                        if(CheckAndAddTrianglePair(&edgeTris, tr, info.tr))
-                            break;
-                        // The two triangles that join at this edge come from
-                        // different faces; either really different faces,
-                        // or one is from a face and the other is zero (i.e.,
-                        // not from a face).
-                        sel->AddEdge(a, b, auxA);
-                    }
-                    break;
+uint32_t SMeshAdjacency::WeldVertex(Vector p) {
+    int64_t cell[3], lo[3], hi[3];
+    for(int i = 0; i < 3; i++) {
+        double c = p.Element(i) / ADJ_CELL_SIZE;
+        cell[i] = (int64_t)floor(c);
+        double f = (c - (double)cell[i])*ADJ_CELL_SIZE;
+        lo[i] = (f < LENGTH_EPS) ? cell[i] - 1 : cell[i];
+        hi[i] = (f > ADJ_CELL_SIZE - LENGTH_EPS) ? cell[i] + 1 : cell[i];
+    }
 
-                case EdgeKind::SHARP:
-                    if(info.count == 1) {
-                        Vector na0 = tr->normals[j].WithMagnitude(1.0);
-                        Vector nb0 = tr->normals[(j + 1) % 3].WithMagnitude(1.0);
-                        Vector na1 = info.tr->normals[info.ai].WithMagnitude(1.0);
-                        Vector nb1 = info.tr->normals[info.bi].WithMagnitude(1.0);
-                        if(!((na0.Equals(na1) && nb0.Equals(nb1)) ||
-                             (na0.Equals(nb1) && nb0.Equals(na1)))) {
-                            if(CheckAndAddTrianglePair(&edgeTris, tr, info.tr))
-                                break;
-                            // The two triangles that join at this edge meet at a sharp
-                            // angle. This implies they come from different faces.
-                            sel->AddEdge(a, b, auxA);
-                        }
-                    }
-                    break;
+    for(int64_t x = lo[0]; x <= hi[0]; x++) {
+        for(int64_t y = lo[1]; y <= hi[1]; y++) {
+            for(int64_t z = lo[2]; z <= hi[2]; z++) {
+                auto range = vertexCells.equal_range(CellHash(x, y, z));
+                for(auto it = range.first; it != range.second; ++it) {
+                    if(vertices[it->second].Equals(p)) return it->second;
+                }
             }
+        }
+    }
+
+    uint32_t v = (uint32_t)vertices.size();
+    vertices.push_back(p);
+    vertexCells.emplace(CellHash(cell[0], cell[1], cell[2]), v);
+    return v;
+}
+
+static uint64_t EdgeKey(uint32_t from, uint32_t to) {
+    return ((uint64_t)from << 32) | to;
+}
+
+void SMeshAdjacency::Build(const std::vector<STriangle *> &tris) {
+    Clear();
+    vertices.reserve(tris.size());
+    halfEdges.reserve(tris.size() * 3);
+    firstEdge.reserve(tris.size() * 3);
 
-            cnt++;
+    for(STriangle *tr : tris) {
+        uint32_t vi[3];
+        for(int j = 0; j < 3; j++) {
+            vi[j] = WeldVertex(tr->vertices[j]);
+        }
+        for(int j = 0; j < 3; j++) {
+            HalfEdge he = {};
+            he.tr       = tr;
+            he.which    = j;
+            he.from     = vi[j];
+            he.to       = vi[(j + 1) % 3];
+            he.nextSame = -1;
+
+            int idx = (int)halfEdges.size();
+            auto it = firstEdge.find(EdgeKey(he.from, he.to));
+            if(it == firstEdge.end()) {
+                firstEdge.emplace(EdgeKey(he.from, he.to), idx);
+            } else {
+                he.nextSame = it->second;
+                it->second  = idx;
+            }
+            halfEdges.push_back(he);
         }
     }
 }
 
-void SKdNode::MakeOutlinesInto(SOutlineList *sol, EdgeKind edgeKind) const
-{
+void SMeshAdjacency::Build(SMesh *m) {
     std::vector<STriangle *> tris;
-    ClearTags();
-    ListTrianglesInto(&tris);
+    tris.reserve(m->l.n);
+    for(STriangle &tr : m->l) {
+        tris.push_back(&tr);
+    }
+    Build(tris);
+}
+
+//-----------------------------------------------------------------------------
+// Return the index of the first half-edge from `from` to `to`, or -1 if
+// there is none, and the number of such half-edges in *count.
+//-----------------------------------------------------------------------------
+int SMeshAdjacency::FindEdges(uint32_t from, uint32_t to, int *count) const {
+    *count = 0;
+    auto it = firstEdge.find(EdgeKey(from, to));
+    if(it == firstEdge.end()) return -1;
+
+    for(int i = it->second; i >= 0; i = halfEdges[i].nextSame) {
+        (*count)++;
+    }
+    return it->second;
+}
+
+//-----------------------------------------------------------------------------
+// Find the anti-parallel mates of a half-edge; report how many there are,
+// and return true (with the mate) if there is exactly one.
+//-----------------------------------------------------------------------------
+bool SMeshAdjacency::FindMate(const HalfEdge &he, const HalfEdge **mate, int *count) const {
+    int first = FindEdges(he.to, he.from, count);
+    if(*count != 1) return false;
+    *mate = &halfEdges[first];
+    return true;
+}
+
+// Whether two triangles that share an edge have different vertex normals
+// along it, meaning that they meet at a sharp angle.
+static bool IsSharpEdge(const SMeshAdjacency::HalfEdge &he,
+                        const SMeshAdjacency::HalfEdge &mate) {
+    const STriangle *tr = he.tr, *mtr = mate.tr;
+    Vector na0 = tr->normals[he.which].WithMagnitude(1.0);
+    Vector nb0 = tr->normals[(he.which + 1) % 3].WithMagnitude(1.0);
+    // The mate runs the other way, so its start is our end.
+    Vector na1 = mtr->normals[(mate.which + 1) % 3].WithMagnitude(1.0);
+    Vector nb1 = mtr->normals[mate.which].WithMagnitude(1.0);
+    return !((na0.Equals(na1) && nb0.Equals(nb1)) ||
+             (na0.Equals(nb1) && nb0.Equals(na1)));
+}
+
+// An edge shared by exactly two triangles is seen once from each side; we
+// report it only from the side with the lower index.
+static bool IsSecondVisit(const SMeshAdjacency &adj, int idx,
+                          const SMeshAdjacency::HalfEdge *mate) {
+    int count;
+    adj.FindEdges(mate->to, mate->from, &count);
+    return count == 1 && (int)(mate - &adj.halfEdges[0]) < idx;
+}
+
+//-----------------------------------------------------------------------------
+// Pick certain classes of edges out from our mesh; see the description for
+// SKdNode::MakeCertainEdgesInto. All the adjacency comes from the half-edges,
+// but testing for self-intersection needs a spatial search, so root may
+// only be NULL when we are not asked for that.
+//-----------------------------------------------------------------------------
+void SMeshAdjacency::MakeCertainEdgesInto(SEdgeList *sel, EdgeKind how,
+                                          const SKdNode *root, bool coplanarIsInter,
+                                          bool *inter, bool *leaky, int auxA) const
+{
+    if(inter) *inter = false;
+    if(leaky) *leaky = false;
+
+    bool testInter = (how == EdgeKind::NAKED_OR_SELF_INTER ||
+                      how == EdgeKind::SELF_INTER);
+    ssassert(!testInter || root != NULL, "Need a kd-tree to test for self-intersection");
 
-    std::set<std::pair<STriangle *, STriangle *>> edgeTris;
     int cnt = 1234;
-    for(STriangle *tr : tris) {
-        for(int j = 0; j < 3; j++) {
-            Vector a = tr->vertices[j];
-            Vector b = tr->vertices[(j + 1) % 3];
+    for(int i = 0; i < (int)halfEdges.size(); i++) {
+        const HalfEdge &he = halfEdges[i];
+        Vector a = he.tr->vertices[he.which];
+        Vector b = he.tr->vertices[(he.which + 1) % 3];
 
+        bool intersectsMesh = false;
+        if(testInter) {
             SKdNode::EdgeOnInfo info = {};
-            FindEdgeOn(a, b, cnt, /*coplanarIsInter=*/false, &info);
-            cnt++;
-            if(info.count != 1) continue;
-            if(CheckAndAddTrianglePair(&edgeTris, tr, info.tr))
-                continue;
+            root->FindEdgeOn(a, b, cnt++, coplanarIsInter, &info);
+            intersectsMesh = info.intersectsMesh;
+        }
 
-            int tag = 0;
-            switch(edgeKind) {
-                case EdgeKind::EMPHASIZED:
-                    if(tr->meta.face != info.tr->meta.face) {
-                        tag = 1;
-                    }
-                    break;
+        const HalfEdge *mate = NULL;
+        int mates;
+        bool hasMate = FindMate(he, &mate, &mates);
+
+        switch(how) {
+            case EdgeKind::NAKED_OR_SELF_INTER: {
+                // there should be one anti-parallel edge, but there may be
+                // multiple parallel coincident edges
+                int parallel;
+                FindEdges(he.from, he.to, &parallel);
+                if(mates != 1 && mates != parallel) {
+                    sel->AddEdge(a, b, auxA);
+                    if(leaky) *leaky = true;
+                }
+                if(intersectsMesh) {
+                    sel->AddEdge(a, b, auxA);
+                    if(inter) *inter = true;
+                }
+                break;
+            }
 
-                case EdgeKind::SHARP: {
-                        Vector na0 = tr->normals[j].WithMagnitude(1.0);
-                        Vector nb0 = tr->normals[(j + 1) % 3].WithMagnitude(1.0);
-                        Vector na1 = info.tr->normals[info.ai].WithMagnitude(1.0);
-                        Vector nb1 = info.tr->normals[info.bi].WithMagnitude(1.0);
-                        if(!((na0.Equals(na1) && nb0.Equals(nb1)) ||
-                             (na0.Equals(nb1) && nb0.Equals(na1)))) {
-                            tag = 1;
-                        }
-                    }
-                    break;
+            case EdgeKind::SELF_INTER:
+                if(intersectsMesh) {
+                    sel->AddEdge(a, b, auxA);
+                    if(inter) *inter = true;
+                }
+                break;
+
+            case EdgeKind::TURNING:
+                // This triangle is back-facing (or on edge), and this edge
+                // has exactly one mate, and that mate is front-facing. So
+                // this is a turning edge.
+                if(hasMate &&
+                   he.tr->Normal().z < LENGTH_EPS &&
+                   mate->tr->Normal().z > LENGTH_EPS)
+                {
+                    sel->AddEdge(a, b, auxA);
+                }
+                break;
+
+            case EdgeKind::EMPHASIZED:
+                // The two triangles that join at this edge come from
+                // different faces; either really different faces, or one
+                // is from a face and the other is zero (i.e., not from a
+                // face).
+                if(hasMate && !IsSecondVisit(*this, i, mate) &&
+                   he.tr->meta.face != mate->tr->meta.face)
+                {
+                    sel->AddEdge(a, b, auxA);
+                }
+                break;
 
-                default:
-                    ssassert(false, "Unexpected edge kind");
-            }
+            case EdgeKind::SHARP:
+                // The two triangles that join at this edge meet at a sharp
+                // angle. This implies they come from different faces.
+                if(hasMate && !IsSecondVisit(*this, i, mate) &&
+                   IsSharpEdge(he, *mate))
+                {
+                    sel->AddEdge(a, b, auxA);
+                }
+                break;
+        }
+    }
+}
+
+void SMeshAdjacency::MakeOutlinesInto(SOutlineList *sol, EdgeKind edgeKind) const {
+    for(int i = 0; i < (int)halfEdges.size(); i++) {
+        const HalfEdge &he = halfEdges[i];
 
-            Vector nl = tr->Normal().WithMagnitude(1.0);
-            Vector nr = info.tr->Normal().WithMagnitude(1.0);
+        const HalfEdge *mate;
+        int mates;
+        if(!FindMate(he, &mate, &mates)) continue;
+        if(IsSecondVisit(*this, i, mate)) continue;
 
-            // We don't add edges with the same left and right
-            // normals because they can't produce outlines.
-            if(tag == 0 && nl.Equals(nr)) continue;
-            sol->AddEdge(a, b, nl, nr, tag);
+        int tag = 0;
+        switch(edgeKind) {
+            case EdgeKind::EMPHASIZED:
+                if(he.tr->meta.face != mate->tr->meta.face) {
+                    tag = 1;
+                }
+                break;
+
+            case EdgeKind::SHARP:
+                if(IsSharpEdge(he, *mate)) {
+                    tag = 1;
+                }
+                break;
+
+            default:
+                ssassert(false, "Unexpected edge kind");
         }
+
+        Vector nl = he.tr->Normal().WithMagnitude(1.0);
+        Vector nr = mate->tr->Normal().WithMagnitude(1.0);
+
+        // We don't add edges with the same left and right
+        // normals because they can't produce outlines.
+        if(tag == 0 && nl.Equals(nr)) continue;
+        sol->AddEdge(he.tr->vertices[he.which],
+                     he.tr->vertices[(he.which + 1) % 3], nl, nr, tag);
     }
 }
 
@@ -5,6 +5,16 @@
 //-----------------------------------------------------------------------------
 #include "solvespace.h"
 #include "config.h"
+#include <atomic>
+#include <cerrno>
+#if !defined(WIN32)
+#   include <csignal>
+#   include <sys/mman.h>
+#   include <sys/socket.h>
+#   include <sys/un.h>
+#   include <sys/wait.h>
+#   include <unistd.h>
+#endif
 
 static void ShowUsage(const std::string &cmd) {
     fprintf(stderr, "Usage: %s <command> <options> <filename> [filename...]", cmd.c_str());
@@ -28,6 +38,11 @@ Common options:
         For non-export commands, the unit is %%, and the default is 1.0 %%.
     -b, --bg-color <on|off>
         Whether to export the background colour in vector formats. Defaults to off.
+    -p, --profile
+        For every input file, prints the time and the temporary memory spent
+        in each phase of regenerating each group to standard output, as one
+        line of JSON. Starting up, loading resources and fonts, and loading
+        the file itself are reported under the group "".
 
 Commands:
     version
@@ -51,6 +66,48 @@ Commands:
         Reloads all imported files, regenerates the sketch, and saves it.
         Note that, although this is not an export command, it uses absolute
         chord tolerance, and can be used to prepare assemblies for export.
+    set-dimension --output <pattern> [--set <constraint>=<value>...]
+                  [--variants <file>] [--view <direction>]
+                  [--chord-tol <tolerance>]
+        Changes the values of dimensions, regenerates what they affect, and
+        saves or exports the sketch, according to the extension of the
+        output: a sketch, mesh, surface, or 2d vector format, the last one
+        viewed from <direction>. A <constraint> is named by its handle, as
+        in c00a or 0xa, or by its comment in the file; a <value> is in mm,
+        or in degrees for an angle. With --variants, <file> is CSV, with a
+        row that names the dimensions after a first column of variant names,
+        and then a row of values for each variant; the '#' symbol in
+        <pattern> is replaced with the variant name. All the variants are
+        written from one load of the sketch.
+    batch --manifest <file> [--jobs <count>] [--report <file>]
+        Runs many commands in one go. Each line of the manifest <file> is
+        one of the commands above, with its options and filenames, as it
+        would be given on the command line; blank lines and lines that start
+        with '#' are ignored. Each filename of each command is one job. The
+        jobs are shared between <count> worker processes (by default, one
+        for each CPU), each of which loads one sketch at a time; fonts and
+        other resources are loaded once, before the workers start. If
+        --report is given, the time taken by each job, and whether it
+        failed, are written to <file> as JSON.
+    serve [--socket <path>]
+        Keeps one sketch loaded, and answers requests to change and export
+        it, read as JSON objects one to a line from standard input, or from
+        clients of the Unix socket at <path>. Every response is one line of
+        JSON, with "ok", the time taken in "ms", and "error" or the result;
+        an "id" in the request is copied to its response. The requests are:
+          {"cmd":"open","file":<path>}      {"cmd":"close"}
+          {"cmd":"save","file":<path>}      {"cmd":"quit"}
+          {"cmd":"set-dimension","constraint":<handle or comment>,
+           "value":<mm or degrees>}
+          {"cmd":"regenerate"}
+          {"cmd":"export-mesh","file":<path>,"chord_tol":<mm>}
+          {"cmd":"export-view","file":<path>,"view":<direction>,
+           "chord_tol":<mm>,"bg_color":<bool>}
+          {"cmd":"export-wireframe","file":<path>,"chord_tol":<mm>}
+          {"cmd":"export-surfaces","file":<path>}
+          {"cmd":"mass-properties"}
+        Only what a change affects is regenerated, and exporting again at
+        the same chord tolerance regenerates nothing more.
 )");
 
     auto FormatListFromFileFilters = [](const std::vector<Platform::FileFilter> &filters) {
@@ -86,19 +143,268 @@ File formats:
     FormatListFromFileFilters(Platform::SurfaceFileFilters).c_str());
 }
 
-static bool RunCommand(const std::vector<std::string> args) {
-    if(args.size() < 2) return false;
+// The camera vectors for a named view direction.
+static bool ViewDirection(const std::string &name, Vector *projRight, Vector *projUp) {
+    if(name == "top") {
+        *projRight = Vector::From(1, 0, 0);
+        *projUp    = Vector::From(0, 0, -1);
+    } else if(name == "bottom") {
+        *projRight = Vector::From(1, 0, 0);
+        *projUp    = Vector::From(0, 0, 1);
+    } else if(name == "left") {
+        *projRight = Vector::From(0, 0, 1);
+        *projUp    = Vector::From(0, 1, 0);
+    } else if(name == "right") {
+        *projRight = Vector::From(0, 0, -1);
+        *projUp    = Vector::From(0, 1, 0);
+    } else if(name == "front") {
+        *projRight = Vector::From(1, 0, 0);
+        *projUp    = Vector::From(0, 1, 0);
+    } else if(name == "back") {
+        *projRight = Vector::From(-1, 0, 0);
+        *projUp    = Vector::From(0, 1, 0);
+    } else if(name == "isometric") {
+        *projRight = Vector::From(0.707,  0.000, -0.707);
+        *projUp    = Vector::From(-0.408, 0.816, -0.408);
+    } else {
+        return false;
+    }
+    return true;
+}
 
-    for(const std::string &arg : args) {
-        if(arg == "--help" || arg == "-h") {
-            ShowUsage(args[0]);
-            return true;
+// The handle that a name gives explicitly, as "c00a" or "0xa".
+static bool ParseConstraintHandle(const std::string &name, hConstraint *hc) {
+    size_t start;
+    if(name.compare(0, 2, "0x") == 0) {
+        start = 2;
+    } else if(name.compare(0, 1, "c") == 0) {
+        start = 1;
+    } else {
+        return false;
+    }
+    if(name.size() == start || name.size() - start > 8 ||
+       name.find_first_not_of("0123456789abcdefABCDEF", start) != std::string::npos) {
+        return false;
+    }
+    hc->v = (uint32_t)strtoul(name.c_str() + start, NULL, 16);
+    return true;
+}
+
+// The constraint named by its handle, as "c00a" or "0xa", or else by the
+// comment that it was given in the file. A comment such as "cafe" reads as a
+// handle too, so a name that means two different constraints is an error.
+static Constraint *FindConstraint(const std::string &name, std::string *error) {
+    Constraint *byHandle = NULL, *byComment = NULL;
+    hConstraint hc;
+    if(ParseConstraintHandle(name, &hc)) {
+        byHandle = SK.constraint.FindByIdNoOops(hc);
+    }
+    for(Constraint &c : SK.constraint) {
+        if(c.type != Constraint::Type::COMMENT && c.comment == name) {
+            byComment = &c;
+            break;
         }
     }
+    if(byHandle && byComment && byHandle != byComment) {
+        *error = "it is the handle of one constraint and the comment of another";
+        return NULL;
+    } else if(!byHandle && !byComment) {
+        *error = "no such constraint";
+        return NULL;
+    }
+    return byHandle ? byHandle : byComment;
+}
 
-    std::function<void(const Platform::Path &)> runner;
+// Sets the value of a dimension the way that editing it on screen would: the
+// value is in mm, or in degrees for an angle, and the sign of a signed
+// distance is kept unless the value is negative.
+static bool SetDimension(Constraint *c, double value, std::string *error) {
+    if(!c->HasLabel() || c->type == Constraint::Type::COMMENT) {
+        *error = "constraint has no value";
+        return false;
+    }
+
+    switch(c->type) {
+        case Constraint::Type::PROJ_PT_DISTANCE:
+        case Constraint::Type::PT_LINE_DISTANCE:
+        case Constraint::Type::PT_FACE_DISTANCE:
+        case Constraint::Type::PT_PLANE_DISTANCE:
+        case Constraint::Type::LENGTH_DIFFERENCE:
+        case Constraint::Type::ARC_ARC_DIFFERENCE:
+        case Constraint::Type::ARC_LINE_DIFFERENCE:
+            c->valA = (c->valA < 0) ? -value : value;
+            break;
 
-    std::vector<Platform::Path> inputFiles;
+        case Constraint::Type::DIAMETER:
+            c->valA = fabs(value);
+            // If displayed as radius, then it's given as radius too.
+            if(c->other) c->valA *= 2;
+            break;
+
+        default:
+            c->valA = fabs(value);
+            break;
+    }
+    SS.MarkGroupDirty(c->group);
+    return true;
+}
+
+// A set of dimensions, by name, and the values to give them.
+typedef std::vector<std::pair<std::string, double>> DimensionValues;
+
+static bool SetDimensions(const DimensionValues &values) {
+    for(const auto &nv : values) {
+        std::string error;
+        Constraint *c = FindConstraint(nv.first, &error);
+        if(!c || !SetDimension(c, nv.second, &error)) {
+            fprintf(stderr, "Cannot set '%s': %s.\n", nv.first.c_str(), error.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Variant {
+    std::string     name;
+    DimensionValues values;
+};
+
+// Reads variants from a CSV file. The first row names the dimensions, after a
+// first column that holds the name of each variant in the rows below.
+static bool ReadVariants(const Platform::Path &filename, std::vector<Variant> *variants) {
+    std::string data;
+    if(!Platform::ReadFile(filename, &data)) {
+        fprintf(stderr, "Cannot read variants '%s'!\n", filename.raw.c_str());
+        return false;
+    }
+
+    // Cells are split at commas, except within double quotes, where a doubled
+    // quote stands for one; the space around each cell is dropped.
+    auto SplitRow = [](const std::string &line) {
+        std::vector<std::string> cells;
+        std::string cell;
+        size_t keep = 0;
+        bool quoted = false;
+        for(size_t i = 0; i < line.size(); i++) {
+            char c = line[i];
+            if(quoted) {
+                if(c != '"') {
+                    cell += c;
+                } else if(i + 1 < line.size() && line[i + 1] == '"') {
+                    cell += c;
+                    i++;
+                } else {
+                    quoted = false;
+                }
+                keep = cell.size();
+            } else if(c == '"') {
+                quoted = true;
+            } else if(c == ',') {
+                cells.push_back(cell.substr(0, keep));
+                cell.clear();
+                keep = 0;
+            } else if(c == ' ' || c == '\t' || c == '\r') {
+                if(!cell.empty()) cell += c;
+            } else {
+                cell += c;
+                keep = cell.size();
+            }
+        }
+        cells.push_back(cell.substr(0, keep));
+        return cells;
+    };
+
+    std::istringstream stream(data);
+    std::string line;
+    std::vector<std::string> header;
+    for(int lineNo = 1; std::getline(stream, line); lineNo++) {
+        if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        std::vector<std::string> cells = SplitRow(line);
+        if(header.empty()) {
+            header = cells;
+            if(header.size() < 2) {
+                fprintf(stderr, "No dimensions named in '%s'.\n", filename.raw.c_str());
+                return false;
+            }
+            continue;
+        }
+        if(cells.size() != header.size()) {
+            fprintf(stderr, "Wrong number of values in line %d of '%s'.\n",
+                    lineNo, filename.raw.c_str());
+            return false;
+        }
+
+        Variant variant;
+        variant.name = cells[0];
+        for(size_t i = 1; i < cells.size(); i++) {
+            double value;
+            char tail;
+            if(sscanf(cells[i].c_str(), "%lf%c", &value, &tail) != 1) {
+                fprintf(stderr, "Bad value '%s' in line %d of '%s'.\n",
+                        cells[i].c_str(), lineNo, filename.raw.c_str());
+                return false;
+            }
+            variant.values.emplace_back(header[i], value);
+        }
+        variants->push_back(variant);
+    }
+    return true;
+}
+
+static bool HasExtensionIn(const Platform::Path &path,
+                           const std::vector<Platform::FileFilter> &filters) {
+    for(const Platform::FileFilter &filter : filters) {
+        for(const std::string &extension : filter.extensions) {
+            if(path.HasExtension(extension)) return true;
+        }
+    }
+    return false;
+}
+
+// Saves or exports the sketch, according to the extension of the output; and
+// returns whether that succeeded, without any errors along the way.
+static bool WriteSketchTo(const Platform::Path &output) {
+    unsigned errors = ErrorCount();
+
+    // Solve for the dimensions that were just set, regenerating just what
+    // changed; otherwise saving would regenerate it all, and exporting surfaces
+    // would write the shell as it was.
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+
+    if(HasExtensionIn(output, Platform::SolveSpaceModelFileFilters)) {
+        if(!SS.SaveToFile(output)) return false;
+    } else if(HasExtensionIn(output, Platform::MeshFileFilters)) {
+        SS.ExportMeshTo(output);
+    } else if(HasExtensionIn(output, Platform::SurfaceFileFilters)) {
+        StepFileWriter sfw = {};
+        sfw.ExportSurfacesTo(output);
+    } else if(HasExtensionIn(output, Platform::VectorFileFilters)) {
+        SS.ExportViewOrWireframeTo(output, /*exportWireframe=*/false);
+    } else {
+        fprintf(stderr, "Unrecognized output format '%s'.\n", output.raw.c_str());
+        return false;
+    }
+    return ErrorCount() == errors;
+}
+
+// A command, as parsed from its arguments, and the files to run it on.
+struct CliCommand {
+    std::string                                 name;
+    std::vector<Platform::Path>                 inputFiles;
+    std::string                                 outputPattern;
+    bool                                        profile;
+    // Writes the output for the sketch that's loaded, and returns whether
+    // it did, apart from errors reported with Error().
+    std::function<bool(const Platform::Path &)> runner;
+};
+
+static bool ParseCommand(const std::vector<std::string> &args, CliCommand *cmd) {
+    cmd->name    = args[1];
+    cmd->profile = false;
+
+    std::function<bool(const Platform::Path &)> &runner = cmd->runner;
+
+    std::vector<Platform::Path> &inputFiles = cmd->inputFiles;
     auto ParseInputFile = [&](size_t &argn) {
         std::string arg = args[argn];
         if(arg[0] != '-') {
@@ -107,7 +413,7 @@ static bool RunCommand(const std::vector<std::string> args) {
         } else return false;
     };
 
-    std::string outputPattern;
+    std::string &outputPattern = cmd->outputPattern;
     auto ParseOutputPattern = [&](size_t &argn) {
         if(argn + 1 < args.size() && (args[argn] == "--output" ||
                                       args[argn] == "-o")) {
@@ -122,28 +428,7 @@ static bool RunCommand(const std::vector<std::string> args) {
         if(argn + 1 < args.size() && (args[argn] == "--view" ||
                                       args[argn] == "-v")) {
             argn++;
-            if(args[argn] == "top") {
-                projRight = Vector::From(1, 0, 0);
-                projUp    = Vector::From(0, 0, -1);
-            } else if(args[argn] == "bottom") {
-                projRight = Vector::From(1, 0, 0);
-                projUp    = Vector::From(0, 0, 1);
-            } else if(args[argn] == "left") {
-                projRight = Vector::From(0, 0, 1);
-                projUp    = Vector::From(0, 1, 0);
-            } else if(args[argn] == "right") {
-                projRight = Vector::From(0, 0, -1);
-                projUp    = Vector::From(0, 1, 0);
-            } else if(args[argn] == "front") {
-                projRight = Vector::From(1, 0, 0);
-                projUp    = Vector::From(0, 1, 0);
-            } else if(args[argn] == "back") {
-                projRight = Vector::From(-1, 0, 0);
-                projUp    = Vector::From(0, 1, 0);
-            } else if(args[argn] == "isometric") {
-                projRight = Vector::From(0.707,  0.000, -0.707);
-                projUp    = Vector::From(-0.408, 0.816, -0.408);
-            } else {
+            if(!ViewDirection(args[argn], &projRight, &projUp)) {
                 fprintf(stderr, "Unrecognized view direction '%s'\n", args[argn].c_str());
             }
             return true;
@@ -176,11 +461,15 @@ static bool RunCommand(const std::vector<std::string> args) {
         } else return false;
     };
 
+    auto ParseProfile = [&](size_t &argn) {
+        if(args[argn] == "--profile" || args[argn] == "-p") {
+            cmd->profile = true;
+            return true;
+        } else return false;
+    };
+
     unsigned width = 0, height = 0;
-    if(args[1] == "version") {
-        fprintf(stderr, "SolveSpace version %s \n\n", PACKAGE_VERSION);
-        return false;
-    } else if(args[1] == "thumbnail") {
+    if(args[1] == "thumbnail") {
         auto ParseSize = [&](size_t &argn) {
             if(argn + 1 < args.size() && args[argn] == "--size") {
                 argn++;
@@ -195,7 +484,8 @@ static bool RunCommand(const std::vector<std::string> args) {
                  ParseOutputPattern(argn) ||
                  ParseViewDirection(argn) ||
                  ParseChordTolerance(argn) ||
-                 ParseSize(argn))) {
+                 ParseSize(argn) ||
+                 ParseProfile(argn))) {
                 fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
                 return false;
             }
@@ -211,7 +501,7 @@ static bool RunCommand(const std::vector<std::string> args) {
             return false;
         }
 
-        runner = [&](const Platform::Path &output) {
+        runner = [=](const Platform::Path &output) {
             Camera camera = {};
             camera.pixelRatio = 1;
             camera.gridFit    = true;
@@ -237,9 +527,10 @@ static bool RunCommand(const std::vector<std::string> args) {
             SS.GW.Draw(&pixmapCanvas);
             pixmapCanvas.FlushFrame();
             pixmapCanvas.FinishFrame();
-            pixmapCanvas.ReadFrame()->WritePng(output, /*flip=*/true);
+            bool written = pixmapCanvas.ReadFrame()->WritePng(output, /*flip=*/true);
 
             pixmapCanvas.Clear();
+            return written;
         };
     } else if(args[1] == "export-view") {
         for(size_t argn = 2; argn < args.size(); argn++) {
@@ -247,7 +538,8 @@ static bool RunCommand(const std::vector<std::string> args) {
                  ParseOutputPattern(argn) ||
                  ParseViewDirection(argn) ||
                  ParseChordTolerance(argn) ||
-                 ParseBgColor(argn))) {
+                 ParseBgColor(argn) ||
+                 ParseProfile(argn))) {
                 fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
                 return false;
             }
@@ -258,61 +550,69 @@ static bool RunCommand(const std::vector<std::string> args) {
             return false;
         }
 
-        runner = [&](const Platform::Path &output) {
+        runner = [=](const Platform::Path &output) {
             SS.GW.projRight          = projRight;
             SS.GW.projUp             = projUp;
             SS.exportChordTol        = chordTol;
             SS.exportBackgroundColor = bg_color;
 
             SS.ExportViewOrWireframeTo(output, /*exportWireframe=*/false);
+            return true;
         };
     } else if(args[1] == "export-wireframe") {
         for(size_t argn = 2; argn < args.size(); argn++) {
             if(!(ParseInputFile(argn) ||
                  ParseOutputPattern(argn) ||
-                 ParseChordTolerance(argn))) {
+                 ParseChordTolerance(argn) ||
+                 ParseProfile(argn))) {
                 fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
                 return false;
             }
         }
 
-        runner = [&](const Platform::Path &output) {
+        runner = [=](const Platform::Path &output) {
             SS.exportChordTol = chordTol;
 
             SS.ExportViewOrWireframeTo(output, /*exportWireframe=*/true);
+            return true;
         };
     } else if(args[1] == "export-mesh") {
         for(size_t argn = 2; argn < args.size(); argn++) {
             if(!(ParseInputFile(argn) ||
                  ParseOutputPattern(argn) ||
-                 ParseChordTolerance(argn))) {
+                 ParseChordTolerance(argn) ||
+                 ParseProfile(argn))) {
                 fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
                 return false;
             }
         }
 
-        runner = [&](const Platform::Path &output) {
+        runner = [=](const Platform::Path &output) {
             SS.exportChordTol = chordTol;
 
             SS.ExportMeshTo(output);
+            return true;
         };
     } else if(args[1] == "export-surfaces") {
         for(size_t argn = 2; argn < args.size(); argn++) {
             if(!(ParseInputFile(argn) ||
-                 ParseOutputPattern(argn))) {
+                 ParseOutputPattern(argn) ||
+                 ParseProfile(argn))) {
                 fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
                 return false;
             }
         }
 
-        runner = [&](const Platform::Path &output) {
+        runner = [=](const Platform::Path &output) {
             StepFileWriter sfw = {};
             sfw.ExportSurfacesTo(output);
+            return true;
         };
     } else if(args[1] == "regenerate") {
         for(size_t argn = 2; argn < args.size(); argn++) {
             if(!(ParseInputFile(argn) ||
-                 ParseChordTolerance(argn))) {
+                 ParseChordTolerance(argn) ||
+                 ParseProfile(argn))) {
                 fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
                 return false;
             }
@@ -320,11 +620,96 @@ static bool RunCommand(const std::vector<std::string> args) {
 
         outputPattern = "%.slvs";
 
-        runner = [&](const Platform::Path &output) {
+        runner = [=](const Platform::Path &output) {
+            SS.exportChordTol = chordTol;
+            // Mesh it all at that tolerance here, since saving only regenerates
+            // what's dirty, and a sketch just loaded is clean.
+            SS.GenerateForExport();
+
+            return SS.SaveToFile(output);
+        };
+    } else if(args[1] == "set-dimension") {
+        DimensionValues values;
+        auto ParseSet = [&](size_t &argn) {
+            if(argn + 1 < args.size() && args[argn] == "--set") {
+                argn++;
+                size_t eq = args[argn].rfind('=');
+                double value;
+                if(eq != std::string::npos &&
+                   sscanf(args[argn].c_str() + eq + 1, "%lf", &value) == 1) {
+                    values.emplace_back(args[argn].substr(0, eq), value);
+                    return true;
+                } else return false;
+            } else return false;
+        };
+
+        std::vector<Variant> variants;
+        bool variantsOkay = true;
+        auto ParseVariants = [&](size_t &argn) {
+            if(argn + 1 < args.size() && args[argn] == "--variants") {
+                argn++;
+                variantsOkay = ReadVariants(Platform::Path::From(args[argn]), &variants);
+                return true;
+            } else return false;
+        };
+
+        for(size_t argn = 2; argn < args.size(); argn++) {
+            if(!(ParseInputFile(argn) ||
+                 ParseOutputPattern(argn) ||
+                 ParseSet(argn) ||
+                 ParseVariants(argn) ||
+                 ParseViewDirection(argn) ||
+                 ParseChordTolerance(argn) ||
+                 ParseProfile(argn))) {
+                fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
+                return false;
+            }
+        }
+        if(!variantsOkay) return false;
+
+        if(values.empty() && variants.empty()) {
+            fprintf(stderr, "At least one dimension must be set.\n");
+            return false;
+        }
+        if(variants.size() > 1 && outputPattern.find('#') == std::string::npos) {
+            fprintf(stderr,
+                    "Output pattern must include a # symbol when using multiple variants!\n");
+            return false;
+        }
+
+        runner = [=](const Platform::Path &output) {
+            // The view only matters for vector output, and is optional.
+            if(!EXACT(projUp.Magnitude() == 0 || projRight.Magnitude() == 0)) {
+                SS.GW.projRight = projRight;
+                SS.GW.projUp    = projUp;
+            }
             SS.exportChordTol = chordTol;
-            SS.exportMode = true;
 
-            SS.SaveToFile(output);
+            if(!SetDimensions(values)) return false;
+            if(variants.empty()) {
+                return WriteSketchTo(output);
+            }
+
+            // The sketch stays loaded from one variant to the next, so only
+            // the groups from the first one with a changed dimension on are
+            // regenerated; and each variant is solved starting from the one
+            // before.
+            bool written = true;
+            for(const Variant &variant : variants) {
+                if(!SetDimensions(variant.values)) return false;
+
+                Platform::Path variantOutput = output;
+                size_t replaceAt = variantOutput.raw.find('#');
+                if(replaceAt != std::string::npos) {
+                    variantOutput.raw.replace(replaceAt, 1, variant.name);
+                }
+                if(WriteSketchTo(variantOutput)) {
+                    fprintf(stderr, "Written variant '%s'.\n", variant.name.c_str());
+                } else {
+                    written = false;
+                }
+            }
+            return written;
         };
     } else {
         fprintf(stderr, "Unrecognized command '%s'.\n", args[1].c_str());
@@ -345,33 +730,846 @@ static bool RunCommand(const std::vector<std::string> args) {
         return false;
     }
 
-    for(const Platform::Path &inputFile : inputFiles) {
-        Platform::Path absInputFile = inputFile.Expand(/*fromCurrentDirectory=*/true);
+    return true;
+}
+
+// Where the output for one of the input files of a command goes.
+static Platform::Path OutputFileFor(const CliCommand &cmd, const Platform::Path &inputFile) {
+    Platform::Path outputFile = Platform::Path::From(cmd.outputPattern);
+    size_t replaceAt = outputFile.raw.find('%');
+    if(replaceAt != std::string::npos) {
+        Platform::Path outputSubst = inputFile.Parent();
+        if(outputSubst.IsEmpty()) {
+            outputSubst = Platform::Path::From(inputFile.FileStem());
+        } else {
+            outputSubst = outputSubst.Join(inputFile.FileStem());
+        }
+        outputFile.raw.replace(replaceAt, 1, outputSubst.raw);
+    }
+    return outputFile;
+}
+
+// Loads one input file, runs the command on it, and forgets it again; and
+// returns whether the output was written, or else why not, if asked. The time
+// taken to load it and to run the command is added to the counters, if those
+// are given.
+static bool RunOnFile(const CliCommand &cmd, const Platform::Path &inputFile,
+                      std::string *error = NULL,
+                      int64_t *loadMicros = NULL, int64_t *runMicros = NULL) {
+    Platform::Path absInputFile = inputFile.Expand(/*fromCurrentDirectory=*/true);
+    Platform::Path outputFile = OutputFileFor(cmd, inputFile);
+    Platform::Path absOutputFile = outputFile.Expand(/*fromCurrentDirectory=*/true);
+
+    if(cmd.profile) {
+        Profile::Clear();
+        Profile::enabled = true;
+    }
+
+    int64_t startMicros = GetMicroseconds();
+    SS.Init();
+    if(!SS.LoadFromFile(absInputFile)) {
+        fprintf(stderr, "Cannot load '%s'!\n", inputFile.raw.c_str());
+        if(error) *error = "cannot load";
+        SK.Clear();
+        SS.Clear();
+        Profile::enabled = false;
+        return false;
+    }
+    SS.AfterNewFile();
+    int64_t loadedMicros = GetMicroseconds();
+    unsigned errors = ErrorCount();
+    bool written = cmd.runner(absOutputFile) && ErrorCount() == errors;
+    if(loadMicros) *loadMicros += loadedMicros - startMicros;
+    if(runMicros)  *runMicros  += GetMicroseconds() - loadedMicros;
+    SK.Clear();
+    SS.Clear();
+
+    if(cmd.profile) {
+        Profile::enabled = false;
+        fprintf(stdout, "%s\n", Profile::ToJson(inputFile.raw).c_str());
+        fflush(stdout);
+    }
+
+    if(!written) {
+        fprintf(stderr, "Cannot write '%s'!\n", outputFile.raw.c_str());
+        if(error) *error = "cannot write";
+        return false;
+    }
+    fprintf(stderr, "Written '%s'.\n", outputFile.raw.c_str());
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Batch mode: many commands, on many files, read from a manifest and run on
+// a pool of worker processes. Every worker has a sketch of its own, without
+// any locking, since the sketch is global; and a worker that crashes takes
+// only its own job down with it.
+//-----------------------------------------------------------------------------
+struct BatchJob {
+    size_t          command;
+    Platform::Path  inputFile;
+};
+
+struct BatchResult {
+    enum class State : uint32_t {
+        PENDING = 0,
+        RUNNING = 1,
+        OKAY    = 2,
+        FAILED  = 3,
+    };
+
+    State       state;
+    int         worker;
+    int64_t     loadMicros;
+    int64_t     runMicros;
+    char        error[256];
+};
+
+// Splits a line of the manifest into arguments, at whitespace except within
+// double quotes.
+static std::vector<std::string> SplitManifestLine(const std::string &line) {
+    std::vector<std::string> args;
+    std::string arg;
+    bool inArg = false, quoted = false;
+    for(char c : line) {
+        if(c == '"') {
+            quoted = !quoted;
+            inArg  = true;
+        } else if(!quoted && isspace((unsigned char)c)) {
+            if(inArg) args.push_back(arg);
+            arg.clear();
+            inArg = false;
+        } else {
+            arg += c;
+            inArg = true;
+        }
+    }
+    if(inArg) args.push_back(arg);
+    return args;
+}
+
+static void RunBatchJob(const std::vector<CliCommand> &commands, const BatchJob &job,
+                        BatchResult *result) {
+    result->loadMicros = 0;
+    result->runMicros  = 0;
+    std::string error;
+    if(RunOnFile(commands[job.command], job.inputFile, &error,
+                 &result->loadMicros, &result->runMicros)) {
+        result->state = BatchResult::State::OKAY;
+    } else {
+        snprintf(result->error, sizeof(result->error), "%s", error.c_str());
+        result->state = BatchResult::State::FAILED;
+    }
+}
+
+static bool RunBatch(const std::vector<std::string> &args) {
+    std::string manifest, report;
+    unsigned workers = std::thread::hardware_concurrency();
+    for(size_t argn = 2; argn < args.size(); argn++) {
+        if(argn + 1 < args.size() && args[argn] == "--manifest") {
+            manifest = args[++argn];
+        } else if(argn + 1 < args.size() && args[argn] == "--report") {
+            report = args[++argn];
+        } else if(argn + 1 < args.size() && args[argn] == "--jobs") {
+            if(sscanf(args[++argn].c_str(), "%u", &workers) != 1 || workers == 0) {
+                fprintf(stderr, "Invalid number of jobs '%s'.\n", args[argn].c_str());
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
+            return false;
+        }
+    }
+    if(manifest.empty()) {
+        fprintf(stderr, "A manifest must be specified.\n");
+        return false;
+    }
+    if(workers == 0) workers = 1;
+
+    std::string manifestData;
+    if(!Platform::ReadFile(Platform::Path::From(manifest), &manifestData)) {
+        fprintf(stderr, "Cannot read manifest '%s'!\n", manifest.c_str());
+        return false;
+    }
+
+    std::vector<CliCommand> commands;
+    std::vector<BatchJob>   jobs;
+    std::istringstream manifestStream(manifestData);
+    std::string line;
+    for(int lineNo = 1; std::getline(manifestStream, line); lineNo++) {
+        std::vector<std::string> lineArgs = SplitManifestLine(line);
+        if(lineArgs.empty() || lineArgs[0][0] == '#') continue;
+        lineArgs.insert(lineArgs.begin(), args[0]);
+
+        CliCommand cmd;
+        if(lineArgs[1] == "batch" || !ParseCommand(lineArgs, &cmd)) {
+            fprintf(stderr, "In manifest line %d.\n", lineNo);
+            return false;
+        }
+        for(const Platform::Path &inputFile : cmd.inputFiles) {
+            jobs.push_back({ commands.size(), inputFile });
+        }
+        commands.push_back(cmd);
+    }
+
+    // Anything that's loaded once for all the sketches is best loaded here,
+    // so that every worker starts with it.
+    SS.fonts.LoadAll();
+
+    int64_t startMicros = GetMicroseconds();
+    size_t resultsSize = std::max((size_t)1, jobs.size()) * sizeof(BatchResult);
+#if defined(WIN32)
+    // No fork() here, so run the jobs one at a time in this process instead.
+    workers = 1;
+    std::vector<BatchResult> resultsStore(jobs.size());
+    BatchResult *results = resultsStore.data();
+    memset(results, 0, resultsSize);
+    for(size_t i = 0; i < jobs.size(); i++) {
+        results[i].state = BatchResult::State::RUNNING;
+        RunBatchJob(commands, jobs[i], &results[i]);
+    }
+#else
+    // The results, and the index of the next job to be taken, are shared
+    // with the workers.
+    BatchResult *results =
+        (BatchResult *)mmap(NULL, resultsSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    std::atomic<size_t> *nextJob =
+        (std::atomic<size_t> *)mmap(NULL, sizeof(std::atomic<size_t>),
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    ssassert(results != MAP_FAILED && nextJob != MAP_FAILED, "Cannot map shared memory");
+    memset(results, 0, resultsSize);
+    new(nextJob) std::atomic<size_t>(0);
+
+    std::set<pid_t> running;
+    auto StartWorker = [&]() {
+        fflush(NULL);
+        pid_t pid = fork();
+        if(pid == 0) {
+            for(size_t i; (i = nextJob->fetch_add(1)) < jobs.size();) {
+                results[i].worker = (int)getpid();
+                results[i].state  = BatchResult::State::RUNNING;
+                RunBatchJob(commands, jobs[i], &results[i]);
+            }
+            fflush(NULL);
+            _exit(0);
+        } else if(pid > 0) {
+            running.insert(pid);
+        } else {
+            perror("fork");
+        }
+    };
+    for(unsigned i = 0; i < workers && i < jobs.size(); i++) {
+        StartWorker();
+    }
 
-        Platform::Path outputFile = Platform::Path::From(outputPattern);
-        size_t replaceAt = outputFile.raw.find('%');
-        if(replaceAt != std::string::npos) {
-            Platform::Path outputSubst = inputFile.Parent();
-            if(outputSubst.IsEmpty()) {
-                outputSubst = Platform::Path::From(inputFile.FileStem());
+    while(!running.empty()) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if(pid < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        running.erase(pid);
+        if(WIFEXITED(status) && WEXITSTATUS(status) == 0) continue;
+
+        // The worker died, so fail the job that it was running, and start
+        // another in its place if there's anything left to do.
+        for(size_t i = 0; i < jobs.size(); i++) {
+            BatchResult *r = &results[i];
+            if(r->state != BatchResult::State::RUNNING || r->worker != (int)pid) continue;
+            if(WIFSIGNALED(status)) {
+                snprintf(r->error, sizeof(r->error), "crashed with signal %d",
+                         WTERMSIG(status));
             } else {
-                outputSubst = outputSubst.Join(inputFile.FileStem());
+                snprintf(r->error, sizeof(r->error), "exited with status %d",
+                         WEXITSTATUS(status));
             }
-            outputFile.raw.replace(replaceAt, 1, outputSubst.raw);
+            r->state = BatchResult::State::FAILED;
         }
-        Platform::Path absOutputFile = outputFile.Expand(/*fromCurrentDirectory=*/true);
+        if(nextJob->load() < jobs.size()) StartWorker();
+    }
+#endif
+    int64_t totalMicros = GetMicroseconds() - startMicros;
 
-        SS.Init();
-        if(!SS.LoadFromFile(absInputFile)) {
-            fprintf(stderr, "Cannot load '%s'!\n", inputFile.raw.c_str());
+    size_t failed = 0;
+    std::string json = ssprintf("{\"workers\":%u,\"total_ms\":%.3f,\"jobs\":[",
+                                workers, totalMicros / 1000.0);
+    for(size_t i = 0; i < jobs.size(); i++) {
+        const CliCommand &cmd = commands[jobs[i].command];
+        const BatchResult &r = results[i];
+        bool okay = (r.state == BatchResult::State::OKAY);
+        if(!okay) failed++;
+
+        if(i > 0) json += ",";
+        json += ssprintf("{\"command\":%s,\"input\":%s,\"output\":%s,\"ok\":%s,"
+                         "\"load_ms\":%.3f,\"run_ms\":%.3f",
+                         JsonString(cmd.name).c_str(),
+                         JsonString(jobs[i].inputFile.raw).c_str(),
+                         JsonString(OutputFileFor(cmd, jobs[i].inputFile).raw).c_str(),
+                         okay ? "true" : "false",
+                         r.loadMicros / 1000.0, r.runMicros / 1000.0);
+        if(!okay) {
+            std::string error = (r.state == BatchResult::State::FAILED) ? r.error : "not run";
+            json += ",\"error\":" + JsonString(error);
+        }
+        json += "}";
+    }
+    json += ssprintf("],\"failed\":%u}\n", (unsigned)failed);
+
+#if !defined(WIN32)
+    munmap(results, resultsSize);
+    munmap(nextJob, sizeof(std::atomic<size_t>));
+#endif
+
+    fprintf(stderr, "Ran %u jobs on %u workers, %u failed.\n",
+            (unsigned)jobs.size(), workers, (unsigned)failed);
+    if(!report.empty() && !Platform::WriteFile(Platform::Path::From(report), json)) {
+        fprintf(stderr, "Cannot write report '%s'!\n", report.c_str());
+        return false;
+    }
+    return failed == 0;
+}
+
+//-----------------------------------------------------------------------------
+// Server mode: one sketch, kept loaded between requests, so that changing it
+// and exporting it again only regenerates what changed. Each request is a
+// JSON object on a line of its own, and gets a response in the same form.
+//-----------------------------------------------------------------------------
+struct JsonField {
+    enum class Type : uint32_t {
+        NUL,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+    };
+
+    Type        type;
+    std::string raw;        // as it was in the request
+    std::string str;
+    double      number;
+    bool        boolean;
+};
+
+typedef std::map<std::string, JsonField> JsonRequest;
+
+class JsonReader {
+public:
+    const std::string &text;
+    size_t             pos;
+    std::string        error;
+
+    JsonReader(const std::string &text) : text(text), pos(0) {}
+
+    void SkipSpace() {
+        while(pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+    }
+
+    bool Expect(char c) {
+        SkipSpace();
+        if(pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        error = ssprintf("expected '%c' at offset %u", c, (unsigned)pos);
+        return false;
+    }
+
+    // The four hex digits of a \u escape.
+    bool ReadHex4(unsigned *cp) {
+        if(pos + 4 > text.size()) {
+            error = "bad \\u escape";
             return false;
         }
-        SS.AfterNewFile();
-        runner(absOutputFile);
+        *cp = 0;
+        for(size_t i = 0; i < 4; i++) {
+            char c = text[pos + i];
+            if(!isxdigit((unsigned char)c)) {
+                error = "bad \\u escape";
+                return false;
+            }
+            *cp = *cp * 16 + (unsigned)(isdigit((unsigned char)c) ? c - '0' :
+                                                                  tolower(c) - 'a' + 10);
+        }
+        pos += 4;
+        return true;
+    }
+
+    // How many characters of JSON number grammar there are at pos, or zero if
+    // there isn't one; strtod() alone would take "nan", "inf" and hex floats too.
+    size_t NumberLength() const {
+        size_t i = pos;
+        auto Digits = [&]() {
+            size_t start = i;
+            while(i < text.size() && isdigit((unsigned char)text[i])) i++;
+            return i - start;
+        };
+        if(i < text.size() && text[i] == '-') i++;
+        if(i < text.size() && text[i] == '0') {
+            i++;
+        } else if(i >= text.size() || text[i] < '1' || text[i] > '9' || Digits() == 0) {
+            return 0;
+        }
+        if(i < text.size() && text[i] == '.') {
+            i++;
+            if(Digits() == 0) return 0;
+        }
+        if(i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+            i++;
+            if(i < text.size() && (text[i] == '+' || text[i] == '-')) i++;
+            if(Digits() == 0) return 0;
+        }
+        return i - pos;
+    }
+
+    bool ReadString(std::string *str) {
+        if(!Expect('"')) return false;
+        str->clear();
+        while(pos < text.size()) {
+            char c = text[pos++];
+            if(c == '"') return true;
+            if(c != '\\') {
+                *str += c;
+                continue;
+            }
+            if(pos >= text.size()) break;
+            c = text[pos++];
+            switch(c) {
+                case 'b': *str += '\b'; break;
+                case 'f': *str += '\f'; break;
+                case 'n': *str += '\n'; break;
+                case 'r': *str += '\r'; break;
+                case 't': *str += '\t'; break;
+                case '"':
+                case '\\':
+                case '/': *str += c; break;
+                case 'u': {
+                    // A character outside the BMP comes as a surrogate pair.
+                    unsigned cp, low;
+                    if(!ReadHex4(&cp)) return false;
+                    if(cp >= 0xdc00 && cp <= 0xdfff) {
+                        error = "unpaired surrogate in \\u escape";
+                        return false;
+                    } else if(cp >= 0xd800 && cp <= 0xdbff) {
+                        if(text.compare(pos, 2, "\\u") != 0) {
+                            error = "unpaired surrogate in \\u escape";
+                            return false;
+                        }
+                        pos += 2;
+                        if(!ReadHex4(&low)) return false;
+                        if(low < 0xdc00 || low > 0xdfff) {
+                            error = "unpaired surrogate in \\u escape";
+                            return false;
+                        }
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    if(cp < 0x80) {
+                        *str += (char)cp;
+                    } else if(cp < 0x800) {
+                        *str += (char)(0xc0 | (cp >> 6));
+                        *str += (char)(0x80 | (cp & 0x3f));
+                    } else if(cp < 0x10000) {
+                        *str += (char)(0xe0 | (cp >> 12));
+                        *str += (char)(0x80 | ((cp >> 6) & 0x3f));
+                        *str += (char)(0x80 | (cp & 0x3f));
+                    } else {
+                        *str += (char)(0xf0 | (cp >> 18));
+                        *str += (char)(0x80 | ((cp >> 12) & 0x3f));
+                        *str += (char)(0x80 | ((cp >> 6) & 0x3f));
+                        *str += (char)(0x80 | (cp & 0x3f));
+                    }
+                    break;
+                }
+                default:
+                    error = ssprintf("bad escape '\\%c'", c);
+                    return false;
+            }
+        }
+        error = "unterminated string";
+        return false;
+    }
+
+    bool ReadField(JsonField *field) {
+        SkipSpace();
+        size_t start = pos;
+        if(pos < text.size() && text[pos] == '"') {
+            field->type = JsonField::Type::STRING;
+            if(!ReadString(&field->str)) return false;
+        } else if(text.compare(pos, 4, "true") == 0) {
+            field->type    = JsonField::Type::BOOLEAN;
+            field->boolean = true;
+            pos += 4;
+        } else if(text.compare(pos, 5, "false") == 0) {
+            field->type    = JsonField::Type::BOOLEAN;
+            field->boolean = false;
+            pos += 5;
+        } else if(text.compare(pos, 4, "null") == 0) {
+            field->type = JsonField::Type::NUL;
+            pos += 4;
+        } else {
+            size_t length = NumberLength();
+            if(length == 0) {
+                error = ssprintf("unexpected value at offset %u", (unsigned)pos);
+                return false;
+            }
+            field->number = strtod(text.substr(pos, length).c_str(), NULL);
+            if(!std::isfinite(field->number)) {
+                error = ssprintf("number out of range at offset %u", (unsigned)pos);
+                return false;
+            }
+            field->type = JsonField::Type::NUMBER;
+            pos += length;
+        }
+        field->raw = text.substr(start, pos - start);
+        return true;
+    }
+
+    // Only a flat object is needed for a request; nested objects and arrays
+    // aren't understood.
+    bool ReadObject(JsonRequest *request) {
+        if(!Expect('{')) return false;
+        SkipSpace();
+        if(pos < text.size() && text[pos] == '}') {
+            pos++;
+            return true;
+        }
+        while(true) {
+            std::string key;
+            SkipSpace();
+            if(!ReadString(&key)) return false;
+            if(!Expect(':')) return false;
+            if(!ReadField(&(*request)[key])) return false;
+            SkipSpace();
+            if(pos < text.size() && text[pos] == ',') {
+                pos++;
+                continue;
+            }
+            return Expect('}');
+        }
+    }
+};
+
+static std::string JsonVector(Vector v) {
+    return ssprintf("[%.17g,%.17g,%.17g]", v.x, v.y, v.z);
+}
+
+static const char *SolveResultName(SolveResult how) {
+    switch(how) {
+        case SolveResult::OKAY:                     return "okay";
+        case SolveResult::DIDNT_CONVERGE:           return "didnt-converge";
+        case SolveResult::REDUNDANT_OKAY:           return "redundant-okay";
+        case SolveResult::REDUNDANT_DIDNT_CONVERGE: return "redundant-didnt-converge";
+        case SolveResult::TOO_MANY_UNKNOWNS:        return "too-many-unknowns";
+    }
+    ssassert(false, "Unexpected solve result");
+}
+
+static std::string DescribeGroups() {
+    std::string json = "\"groups\":[";
+    bool first = true;
+    for(hGroup hg : SK.groupOrder) {
+        Group *g = SK.GetGroup(hg);
+        if(!first) json += ",";
+        first = false;
+        json += ssprintf("{\"group\":%s,\"name\":%s,\"result\":\"%s\",\"dof\":%d}",
+                         JsonString(ssprintf("g%03x", hg.v)).c_str(),
+                         JsonString(g->name).c_str(),
+                         SolveResultName(g->solved.how), g->solved.dof);
+    }
+    json += "]";
+    return json;
+}
+
+class Server {
+public:
+    bool        loaded = false;
+    bool        quit   = false;
+
+    // Handles one request, and returns the fields of the response after "ok";
+    // or false, with an error.
+    bool Handle(const JsonRequest &request, std::string *response, std::string *error) {
+        auto Field = [&](const char *name) -> const JsonField * {
+            auto it = request.find(name);
+            return (it == request.end()) ? NULL : &it->second;
+        };
+        auto StringField = [&](const char *name, std::string *str) {
+            const JsonField *f = Field(name);
+            if(!f || f->type != JsonField::Type::STRING) {
+                *error = ssprintf("'%s' must be a string", name);
+                return false;
+            }
+            *str = f->str;
+            return true;
+        };
+        auto NumberField = [&](const char *name, double *number) {
+            const JsonField *f = Field(name);
+            if(!f) return true;
+            if(f->type != JsonField::Type::NUMBER) {
+                *error = ssprintf("'%s' must be a number", name);
+                return false;
+            }
+            *number = f->number;
+            return true;
+        };
+
+        std::string cmd;
+        if(!StringField("cmd", &cmd)) return false;
+
+        if(cmd == "quit") {
+            quit = true;
+            return true;
+        } else if(cmd == "open") {
+            std::string file;
+            if(!StringField("file", &file)) return false;
+            Close();
+            SS.Init();
+            Platform::Path path = Platform::Path::From(file).Expand(/*fromCurrentDirectory=*/true);
+            if(!SS.LoadFromFile(path)) {
+                SK.Clear();
+                SS.Clear();
+                *error = "cannot load '" + file + "'";
+                return false;
+            }
+            SS.AfterNewFile();
+            loaded = true;
+            *response = DescribeGroups();
+            return true;
+        } else if(cmd == "close") {
+            Close();
+            return true;
+        }
+
+        if(!loaded) {
+            *error = "no sketch is open";
+            return false;
+        }
+
+        if(cmd == "save") {
+            std::string file;
+            if(!StringField("file", &file)) return false;
+            if(!SS.SaveToFile(Platform::Path::From(file).Expand(/*fromCurrentDirectory=*/true))) {
+                *error = "cannot save '" + file + "'";
+                return false;
+            }
+        } else if(cmd == "set-dimension") {
+            const JsonField *name = Field("constraint");
+            Constraint *c = NULL;
+            if(name && name->type == JsonField::Type::STRING) {
+                c = FindConstraint(name->str, error);
+            } else if(name && name->type == JsonField::Type::NUMBER) {
+                // A number can only be a handle.
+                hConstraint hc = { (uint32_t)name->number };
+                c = SK.constraint.FindByIdNoOops(hc);
+                if(!c) *error = "no such constraint";
+            } else {
+                *error = "'constraint' must be a string or a number";
+            }
+            if(!c) return false;
+            const JsonField *value = Field("value");
+            if(!value || value->type != JsonField::Type::NUMBER) {
+                *error = "'value' must be a number";
+                return false;
+            }
+            if(!SetDimension(c, value->number, error)) return false;
+        } else if(cmd == "regenerate") {
+            SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+            *response = DescribeGroups();
+        } else if(cmd == "export-mesh" || cmd == "export-view" ||
+                  cmd == "export-wireframe" || cmd == "export-surfaces") {
+            std::string file;
+            if(!StringField("file", &file)) return false;
+            Platform::Path path = Platform::Path::From(file).Expand(/*fromCurrentDirectory=*/true);
+
+            double chordTol = 1.0;
+            if(!NumberField("chord_tol", &chordTol)) return false;
+            SS.exportChordTol = chordTol;
+
+            unsigned errors = ErrorCount();
+            if(cmd == "export-mesh") {
+                SS.ExportMeshTo(path);
+            } else if(cmd == "export-surfaces") {
+                // The other exports solve what's changed themselves.
+                SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+                StepFileWriter sfw = {};
+                sfw.ExportSurfacesTo(path);
+            } else {
+                if(cmd == "export-view") {
+                    std::string view;
+                    if(!StringField("view", &view)) return false;
+                    if(!ViewDirection(view, &SS.GW.projRight, &SS.GW.projUp)) {
+                        *error = "unrecognized view direction '" + view + "'";
+                        return false;
+                    }
+                    const JsonField *bgColor = Field("bg_color");
+                    SS.exportBackgroundColor =
+                        bgColor && bgColor->type == JsonField::Type::BOOLEAN && bgColor->boolean;
+                }
+                SS.ExportViewOrWireframeTo(path, /*exportWireframe=*/cmd == "export-wireframe");
+            }
+            if(ErrorCount() != errors) {
+                *error = "cannot export to '" + file + "'";
+                return false;
+            }
+            *response = DescribeGroups();
+        } else if(cmd == "mass-properties") {
+            SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+            Group *g = SK.GetGroup(SS.GW.activeGroup);
+            g->GenerateDisplayItems();
+            const SMesh &m = g->displayMesh;
+
+            double volume = m.CalculateVolume(), area = 0.0;
+            for(const STriangle &tr : m.l) {
+                area += tr.Area();
+            }
+            *response = ssprintf("\"group\":%s,\"triangles\":%d,\"volume\":%.17g,\"area\":%.17g",
+                                 JsonString(ssprintf("g%03x", g->h.v)).c_str(),
+                                 m.l.n, volume, area);
+            if(volume != 0.0) {
+                *response += ",\"center_of_mass\":" + JsonVector(m.GetCenterOfMass());
+            }
+        } else {
+            *error = "unrecognized command '" + cmd + "'";
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if(!loaded) return;
         SK.Clear();
         SS.Clear();
+        loaded = false;
+    }
+
+    // Answers requests from one client, until it hangs up or asks us to quit.
+    void Serve(FILE *in, FILE *out) {
+        std::string line;
+        while(!quit) {
+            line.clear();
+            int c;
+            while((c = fgetc(in)) != EOF && c != '\n') {
+                line += (char)c;
+            }
+            if(c == EOF && line.empty()) break;
+            if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+            JsonRequest request;
+            JsonReader reader(line);
+            std::string response, error;
+            int64_t startMicros = GetMicroseconds();
+            bool okay = reader.ReadObject(&request);
+            if(!okay) {
+                error = "bad request: " + reader.error;
+            } else {
+                okay = Handle(request, &response, &error);
+            }
+
+            std::string json = "{";
+            auto id = request.find("id");
+            if(id != request.end()) json += "\"id\":" + id->second.raw + ",";
+            json += ssprintf("\"ok\":%s,\"ms\":%.3f", okay ? "true" : "false",
+                             (GetMicroseconds() - startMicros) / 1000.0);
+            if(!okay) {
+                json += ",\"error\":" + JsonString(error);
+            } else if(!response.empty()) {
+                json += "," + response;
+            }
+            json += "}\n";
+            fputs(json.c_str(), out);
+            fflush(out);
+        }
+    }
+};
+
+static bool RunServer(const std::vector<std::string> &args) {
+    std::string socketPath;
+    for(size_t argn = 2; argn < args.size(); argn++) {
+        if(argn + 1 < args.size() && args[argn] == "--socket") {
+            socketPath = args[++argn];
+        } else {
+            fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
+            return false;
+        }
+    }
+
+    // Anything that's loaded once for all the sketches is best loaded now,
+    // rather than while answering the first request that needs it.
+    SS.fonts.LoadAll();
+
+    Server server;
+    if(socketPath.empty()) {
+        server.Serve(stdin, stdout);
+        server.Close();
+        return true;
+    }
+
+#if defined(WIN32)
+    fprintf(stderr, "Serving on a socket is not supported on this platform.\n");
+    return false;
+#else
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if(listenFd < 0 || socketPath.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Cannot create socket '%s'!\n", socketPath.c_str());
+        return false;
+    }
+    strcpy(addr.sun_path, socketPath.c_str());
+    unlink(socketPath.c_str());
+    if(bind(listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, 4) < 0) {
+        fprintf(stderr, "Cannot listen on socket '%s'!\n", socketPath.c_str());
+        close(listenFd);
+        return false;
+    }
+    // A client that hangs up before reading its response mustn't take the
+    // server down with it.
+    signal(SIGPIPE, SIG_IGN);
+
+    // Clients are answered one at a time, and they all share the one sketch.
+    while(!server.quit) {
+        int fd = accept(listenFd, NULL, NULL);
+        if(fd < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        FILE *in  = fdopen(fd, "r");
+        FILE *out = fdopen(dup(fd), "w");
+        if(in && out) server.Serve(in, out);
+        if(in)  fclose(in);
+        if(out) fclose(out);
+    }
+    server.Close();
+    close(listenFd);
+    unlink(socketPath.c_str());
+    return true;
+#endif
+}
+
+static bool RunCommand(const std::vector<std::string> args) {
+    if(args.size() < 2) return false;
+
+    for(const std::string &arg : args) {
+        if(arg == "--help" || arg == "-h") {
+            ShowUsage(args[0]);
+            return true;
+        }
+    }
+
+    if(args[1] == "version") {
+        fprintf(stderr, "SolveSpace version %s \n\n", PACKAGE_VERSION);
+        return false;
+    } else if(args[1] == "batch") {
+        return RunBatch(args);
+    } else if(args[1] == "serve") {
+        return RunServer(args);
+    }
+
+    CliCommand cmd;
+    if(!ParseCommand(args, &cmd)) return false;
 
-        fprintf(stderr, "Written '%s'.\n", outputFile.raw.c_str());
+    for(const Platform::Path &inputFile : cmd.inputFiles) {
+        if(!RunOnFile(cmd, inputFile)) return false;
     }
 
     return true;
@@ -11,6 +11,12 @@
 using namespace SolveSpace;
 
 int main(int argc, char** argv) {
+    // If asked to, report where the time goes until the first file is open,
+    // as one line of JSON in the debug output.
+    bool startupProfile = (getenv("SOLVESPACE_STARTUP_PROFILE") != NULL);
+    int64_t startMicros = GetMicroseconds();
+    Profile::enabled = startupProfile;
+
     std::vector<std::string> args = Platform::InitGui(argc, argv);
 
     Platform::Open3DConnexion();
@@ -24,6 +30,12 @@ int main(int argc, char** argv) {
         SS.Load(Platform::Path::From(args.back()));
     }
 
+    if(startupProfile) {
+        Profile::enabled = false;
+        dbp("startup took %.3f ms", (GetMicroseconds() - startMicros) / 1000.0);
+        dbp("%s", Profile::ToJson(args.size() >= 2 ? args.back() : "").c_str());
+    }
+
     Platform::RunGui();
 
     Platform::Close3DConnexion();
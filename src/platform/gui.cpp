@@ -100,6 +100,7 @@ std::vector<FileFilter> MeshFileFilters = {
     { CN_("file-type", "Three.js-compatible mesh, with viewer"), { "html" } },
     { CN_("file-type", "Three.js-compatible mesh, mesh only"), { "js" } },
     { CN_("file-type", "VRML text file"), { "wrl" } },
+    { CN_("file-type", "glTF 2.0 binary mesh"), { "glb" } },
 };
 
 std::vector<FileFilter> SurfaceFileFilters = {
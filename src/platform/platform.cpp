@@ -17,8 +17,11 @@
 #   include <windows.h>
 #   include <shellapi.h>
 #else
+#   include <fcntl.h>
 #   include <unistd.h>
+#   include <sys/mman.h>
 #   include <sys/stat.h>
+#   include <errno.h>
 #endif
 
 namespace SolveSpace {
@@ -426,6 +429,72 @@ void RemoveFile(const Platform::Path &filename) {
 #endif
 }
 
+// Replaces any file that's already at the destination, atomically if the
+// platform can.
+bool RenameFile(const Platform::Path &from, const Platform::Path &to) {
+    ssassert(from.raw.length() == strlen(from.raw.c_str()) &&
+             to.raw.length() == strlen(to.raw.c_str()),
+             "Unexpected null byte in middle of a path");
+#if defined(WIN32)
+    return MoveFileExW(Widen(from.Expand().raw).c_str(), Widen(to.Expand().raw).c_str(),
+                       MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.raw.c_str(), to.raw.c_str()) == 0;
+#endif
+}
+
+bool StatFile(const Platform::Path &filename, uint64_t *size, int64_t *mtime) {
+    ssassert(filename.raw.length() == strlen(filename.raw.c_str()),
+             "Unexpected null byte in middle of a path");
+#if defined(WIN32)
+    struct _stat64 st;
+    if(_wstat64(Widen(filename.Expand().raw).c_str(), &st) != 0) return false;
+#else
+    struct stat st;
+    if(stat(filename.raw.c_str(), &st) != 0) return false;
+#endif
+    *size  = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+static bool MakeDirectory(const Platform::Path &dirname) {
+#if defined(WIN32)
+    return CreateDirectoryW(Widen(dirname.raw).c_str(), NULL) ||
+           GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    return mkdir(dirname.raw.c_str(), 0777) == 0 || errno == EEXIST;
+#endif
+}
+
+Platform::Path CacheDirectory() {
+    Platform::Path cacheHome;
+#if defined(WIN32)
+    if(const wchar_t *localAppData = _wgetenv(L"LOCALAPPDATA")) {
+        cacheHome = Path::From(Narrow(localAppData));
+    }
+    if(cacheHome.IsEmpty()) return cacheHome;
+    cacheHome = cacheHome.Join("SolveSpace");
+#elif defined(__APPLE__)
+    if(const char *home = getenv("HOME")) {
+        cacheHome = Path::From(home).Join("Library").Join("Caches");
+    }
+    if(cacheHome.IsEmpty()) return cacheHome;
+    cacheHome = cacheHome.Join("SolveSpace");
+#else
+    if(const char *xdgCacheHome = getenv("XDG_CACHE_HOME")) {
+        cacheHome = Path::From(xdgCacheHome);
+    } else if(const char *home = getenv("HOME")) {
+        cacheHome = Path::From(home).Join(".cache");
+    }
+    if(cacheHome.IsEmpty()) return cacheHome;
+    if(!MakeDirectory(cacheHome)) return Path::From("");
+    cacheHome = cacheHome.Join("solvespace");
+#endif
+    if(!MakeDirectory(cacheHome)) return Path::From("");
+    return cacheHome;
+}
+
 bool ReadFile(const Platform::Path &filename, std::string *data) {
     FILE *f = OpenFile(filename, "rb");
     if(f == NULL) return false;
@@ -455,6 +524,100 @@ bool WriteFile(const Platform::Path &filename, const std::string &data) {
     return true;
 }
 
+#if defined(WIN32)
+
+bool MappedFile::Map(const Platform::Path &filename) {
+    Unmap();
+
+    HANDLE h = CreateFileW(Widen(filename.Expand(/*fromCurrentDirectory=*/true).raw).c_str(),
+                           GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(h == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(h, &fileSize)) {
+        CloseHandle(h);
+        return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+    if(size == 0) {
+        // Can't map an empty file, but there's nothing to read anyway.
+        CloseHandle(h);
+        data = "";
+        return true;
+    }
+
+    HANDLE hMapping = CreateFileMappingW(h, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(h);
+    if(hMapping != NULL) {
+        mapping = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(hMapping);
+    }
+    if(mapping == NULL) {
+        size = 0;
+        return false;
+    }
+
+    data = (const char *)mapping;
+    return true;
+}
+
+void MappedFile::Unmap() {
+    if(mapping != NULL) {
+        UnmapViewOfFile(mapping);
+    }
+    mapping = NULL;
+    data    = NULL;
+    size    = 0;
+}
+
+#else
+
+bool MappedFile::Map(const Platform::Path &filename) {
+    Unmap();
+
+    int fd = open(filename.raw.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    size = (size_t)st.st_size;
+    if(size == 0) {
+        // Can't map an empty file, but there's nothing to read anyway.
+        close(fd);
+        data = "";
+        return true;
+    }
+
+    void *ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(ptr == MAP_FAILED) {
+        size = 0;
+        return false;
+    }
+#if defined(POSIX_MADV_SEQUENTIAL)
+    posix_madvise(ptr, size, POSIX_MADV_SEQUENTIAL);
+#endif
+
+    mapping = ptr;
+    data    = (const char *)ptr;
+    return true;
+}
+
+void MappedFile::Unmap() {
+    if(mapping != NULL) {
+        munmap(mapping, size);
+    }
+    mapping = NULL;
+    data    = NULL;
+    size    = 0;
+}
+
+#endif
+
 //-----------------------------------------------------------------------------
 // Loading resources, on Windows.
 //-----------------------------------------------------------------------------
@@ -685,30 +848,117 @@ void DebugPrint(const char *fmt, ...) {
 // Temporary arena.
 //-----------------------------------------------------------------------------
 
-struct MimallocHeap {
-    mi_heap_t *heap = NULL;
+struct TemporaryArena {
+    mi_heap_t  *heap        = NULL;
+    const char *name        = NULL;
+    uint64_t    allocations = 0;
+    uint64_t    bytes       = 0;
+    uint64_t    liveAtStart = 0;
+    uint64_t    peakLive    = 0;
+};
 
-    ~MimallocHeap() {
-        if(heap != NULL)
-            mi_heap_destroy(heap);
+// The bottom of the stack is the arena that lives until FreeAllTemporary();
+// each TemporaryScope pushes another on top of it.
+struct TemporaryArenaStack {
+    std::vector<TemporaryArena> arenas;
+    uint64_t                    liveBytes = 0;
+    uint64_t                    totalAllocations = 0;
+    uint64_t                    totalBytes = 0;
+
+    std::map<std::string, TemporaryStats> stats;
+
+    TemporaryArena &Top() {
+        if(arenas.empty()) arenas.emplace_back();
+        return arenas.back();
+    }
+
+    ~TemporaryArenaStack() {
+        for(TemporaryArena &arena : arenas) {
+            if(arena.heap != NULL)
+                mi_heap_destroy(arena.heap);
+        }
     }
 };
 
-static thread_local MimallocHeap TempArena;
+static thread_local TemporaryArenaStack TempArenas;
 
 void *AllocTemporary(size_t size) {
-    if(TempArena.heap == NULL) {
-        TempArena.heap = mi_heap_new();
-        ssassert(TempArena.heap != NULL, "out of memory");
+    TemporaryArena &arena = TempArenas.Top();
+    if(arena.heap == NULL) {
+        arena.heap = mi_heap_new();
+        ssassert(arena.heap != NULL, "out of memory");
     }
-    void *ptr = mi_heap_zalloc(TempArena.heap, size);
+    void *ptr = mi_heap_zalloc(arena.heap, size);
     ssassert(ptr != NULL, "out of memory");
+
+    arena.allocations++;
+    arena.bytes += size;
+    TempArenas.liveBytes += size;
+    TempArenas.totalAllocations++;
+    TempArenas.totalBytes += size;
+    arena.peakLive = std::max(arena.peakLive, TempArenas.liveBytes);
     return ptr;
 }
 
 void FreeAllTemporary() {
-    MimallocHeap temp;
-    std::swap(TempArena.heap, temp.heap);
+    if(TempArenas.arenas.empty()) return;
+    ssassert(TempArenas.arenas.size() == 1,
+             "Freeing all temporaries within a temporary scope");
+
+    TemporaryArena &arena = TempArenas.arenas[0];
+    if(arena.heap != NULL)
+        mi_heap_destroy(arena.heap);
+    arena = {};
+    TempArenas.liveBytes = 0;
+}
+
+TemporaryScope::TemporaryScope(const char *name) {
+    TempArenas.Top();
+
+    TemporaryArena arena = {};
+    arena.name        = name;
+    arena.liveAtStart = TempArenas.liveBytes;
+    arena.peakLive    = TempArenas.liveBytes;
+    TempArenas.arenas.push_back(arena);
+}
+
+TemporaryScope::~TemporaryScope() {
+    ssassert(TempArenas.arenas.size() > 1, "Unbalanced temporary scope");
+
+    TemporaryArena arena = TempArenas.arenas.back();
+    TempArenas.arenas.pop_back();
+    if(arena.heap != NULL)
+        mi_heap_destroy(arena.heap);
+    TempArenas.liveBytes -= arena.bytes;
+
+    // Anything that was live within this scope was also live within the
+    // enclosing one.
+    TemporaryArena &parent = TempArenas.arenas.back();
+    parent.peakLive = std::max(parent.peakLive, arena.peakLive);
+
+    TemporaryStats &st = TempArenas.stats[arena.name];
+    st.name = arena.name;
+    st.count++;
+    st.allocations += arena.allocations;
+    st.totalBytes  += arena.bytes;
+    st.peakBytes    = std::max(st.peakBytes, arena.peakLive - arena.liveAtStart);
+}
+
+std::vector<TemporaryStats> GetTemporaryStats() {
+    std::vector<TemporaryStats> result;
+    for(const auto &it : TempArenas.stats) {
+        result.push_back(it.second);
+    }
+    return result;
+}
+
+void ResetTemporaryStats() {
+    TempArenas.stats.clear();
+}
+
+void GetTemporaryCounters(uint64_t *allocations, uint64_t *bytes) {
+    *allocations = TempArenas.totalAllocations;
+    *bytes       = TempArenas.totalBytes;
 }
 
 }
@@ -66,6 +66,32 @@ FILE *OpenFile(const Platform::Path &filename, const char *mode);
 bool ReadFile(const Platform::Path &filename, std::string *data);
 bool WriteFile(const Platform::Path &filename, const std::string &data);
 void RemoveFile(const Platform::Path &filename);
+bool RenameFile(const Platform::Path &from, const Platform::Path &to);
+// The size and modification time (in seconds) of a file, to tell whether it
+// changed since it was last looked at.
+bool StatFile(const Platform::Path &filename, uint64_t *size, int64_t *mtime);
+// A per-user directory for caches that can be rebuilt at any time; created if
+// needed. Empty if there is nowhere to put one.
+Platform::Path CacheDirectory();
+
+// The contents of a file, mapped read-only into memory. The data is not
+// null-terminated, and is valid until the file is unmapped.
+class MappedFile {
+public:
+    const char *data = NULL;
+    size_t      size = 0;
+
+    bool Map(const Platform::Path &filename);
+    void Unmap();
+
+    MappedFile() {}
+    ~MappedFile() { Unmap(); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+private:
+    void       *mapping = NULL;
+};
 
 // Resource loading function.
 const void *LoadResource(const std::string &name, size_t *size);
@@ -80,6 +106,32 @@ void DebugPrint(const char *fmt, ...);
 void *AllocTemporary(size_t size);
 void FreeAllTemporary();
 
+// While a TemporaryScope exists, AllocTemporary allocates from an arena of its
+// own, which is freed all at once when the scope is destroyed; so nothing that
+// is allocated within the scope may be used after it ends. Scopes nest, and
+// are specific to the thread that creates them.
+class TemporaryScope {
+public:
+    TemporaryScope(const char *name);
+    ~TemporaryScope();
+
+    TemporaryScope(const TemporaryScope &) = delete;
+    TemporaryScope &operator=(const TemporaryScope &) = delete;
+};
+
+// Statistics for the temporary scopes entered on the current thread, by name.
+struct TemporaryStats {
+    std::string name;
+    uint64_t    count;          // times the scope was entered
+    uint64_t    allocations;
+    uint64_t    totalBytes;
+    uint64_t    peakBytes;      // most bytes live within a single instance
+};
+std::vector<TemporaryStats> GetTemporaryStats();
+void ResetTemporaryStats();
+// Allocations made with AllocTemporary on the current thread, ever.
+void GetTemporaryCounters(uint64_t *allocations, uint64_t *bytes);
+
 }
 
 #endif
@@ -549,6 +549,75 @@ void SPointList::Add(Vector pt) {
     l.Add(&p);
 }
 
+//-----------------------------------------------------------------------------
+// The cells are much bigger than the tolerance, so that a point almost always
+// has all of its possible matches within its own cell, and the neighbouring
+// cells only need to be looked at when it's right at the edge of one. Cells
+// whose hashes collide just share a chain, which is harmless.
+//-----------------------------------------------------------------------------
+static const double POINT_INDEX_CELL = 256 * LENGTH_EPS;
+
+int64_t SPointIndex::CellCoord(double c) {
+    c = floor(c / POINT_INDEX_CELL);
+    return (int64_t)max(-4e18, min(4e18, c));
+}
+
+uint64_t SPointIndex::CellFor(int64_t x, int64_t y, int64_t z) {
+    uint64_t h = (uint64_t)x * 0x9e3779b97f4a7c15ull;
+    h = (h ^ (h >> 29)) + (uint64_t)y * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 29)) + (uint64_t)z * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+int SPointIndex::Find(Vector pt) const {
+    // The cells that something within LENGTH_EPS of the point could be in.
+    int64_t cells[3][3];
+    int count[3];
+    for(int i = 0; i < 3; i++) {
+        double c = pt.Element(i);
+        count[i] = 0;
+        cells[i][count[i]++] = CellCoord(c);
+        if(CellCoord(c - LENGTH_EPS) != cells[i][0]) cells[i][count[i]++] = cells[i][0] - 1;
+        if(CellCoord(c + LENGTH_EPS) != cells[i][0]) cells[i][count[i]++] = cells[i][0] + 1;
+    }
+
+    // Of all the matches, the first seen, as SPointList::IndexForPoint.
+    int found = -1;
+    for(int i = 0; i < count[0]; i++) {
+        for(int j = 0; j < count[1]; j++) {
+            for(int k = 0; k < count[2]; k++) {
+                auto it = cellFirst.find(CellFor(cells[0][i], cells[1][j], cells[2][k]));
+                if(it == cellFirst.end()) continue;
+                for(int index = it->second; index >= 0; index = cellNext[index]) {
+                    if((found < 0 || index < found) && pt.Equals(points[index])) {
+                        found = index;
+                    }
+                }
+            }
+        }
+    }
+    return found;
+}
+
+int SPointIndex::IndexFor(Vector pt) {
+    int index = Find(pt);
+    if(index >= 0) return index;
+
+    index = (int)points.size();
+    points.push_back(pt);
+    auto it = cellFirst.emplace(CellFor(CellCoord(pt.x), CellCoord(pt.y), CellCoord(pt.z)),
+                                -1).first;
+    cellNext.push_back(it->second);
+    it->second = index;
+    return index;
+}
+
+void SPointIndex::Clear() {
+    points.clear();
+    cellFirst.clear();
+    cellNext.clear();
+}
+
 void SContour::AddPoint(Vector p) {
     SPoint sp;
     sp.tag = 0;
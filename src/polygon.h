@@ -112,6 +112,25 @@ public:
     void Add(Vector pt);
 };
 
+// Numbers distinct points in the order they're first seen, with points that
+// are Equals() being the same point, just like SPointList; but the points are
+// found through a hash of the grid cell they're in, not by a linear search.
+class SPointIndex {
+public:
+    std::vector<Vector> points;
+
+    int IndexFor(Vector pt);
+    int Find(Vector pt) const;
+    void Clear();
+
+private:
+    std::unordered_map<uint64_t, int> cellFirst;
+    std::vector<int>                  cellNext;
+
+    static int64_t CellCoord(double c);
+    static uint64_t CellFor(int64_t x, int64_t y, int64_t z);
+};
+
 class SContour {
 public:
     int             tag;
@@ -354,7 +373,6 @@ public:
     void FindEdgeOn(Vector a, Vector b, int cnt, bool coplanarIsInter, EdgeOnInfo *info) const;
     void MakeCertainEdgesInto(SEdgeList *sel, EdgeKind how, bool coplanarIsInter,
                               bool *inter, bool *leaky, int auxA = 0) const;
-    void MakeOutlinesInto(SOutlineList *sel, EdgeKind tagKind) const;
 
     void OcclusionTestLine(SEdge orig, SEdgeList *sel, int cnt) const;
     void SplitLinesAgainstTriangle(SEdgeList *sel, STriangle *tr) const;
@@ -363,6 +381,39 @@ public:
     void SnapToVertex(Vector v, SMesh *extras);
 };
 
+// Half-edge adjacency for a triangle mesh. Coincident vertices are welded
+// once, and every directed triangle edge is linked to the other edges that
+// run between the same two vertices, so that the mates of an edge can be
+// found without a spatial search.
+class SMeshAdjacency {
+public:
+    struct HalfEdge {
+        STriangle  *tr;
+        int         which;      // from tr->vertices[which] to the next one
+        uint32_t    from;
+        uint32_t    to;
+        int         nextSame;   // next half-edge from `from` to `to`, or -1
+    };
+
+    std::vector<Vector>                 vertices;
+    std::vector<HalfEdge>               halfEdges;
+    std::unordered_map<uint64_t, int>   firstEdge;
+    std::unordered_multimap<uint64_t, uint32_t> vertexCells;
+
+    void Clear();
+    void Build(SMesh *m);
+    void Build(const std::vector<STriangle *> &tris);
+    uint32_t WeldVertex(Vector p);
+
+    int FindEdges(uint32_t from, uint32_t to, int *count) const;
+    bool FindMate(const HalfEdge &he, const HalfEdge **mate, int *count) const;
+
+    void MakeCertainEdgesInto(SEdgeList *sel, EdgeKind how,
+                              const SKdNode *root, bool coplanarIsInter,
+                              bool *inter, bool *leaky, int auxA = 0) const;
+    void MakeOutlinesInto(SOutlineList *sol, EdgeKind tagKind) const;
+};
+
 class PolylineBuilder {
 public:
     struct Edge;
@@ -15,6 +15,7 @@ namespace SolveSpace {
 //-----------------------------------------------------------------------------
 
 std::string LoadString(const std::string &name) {
+    ProfileScope profile(hGroup{}, Profile::Phase::RESOURCES);
     size_t size;
     const void *data = Platform::LoadResource(name, &size);
     std::string result(static_cast<const char *>(data), size);
@@ -29,6 +30,7 @@ std::string LoadString(const std::string &name) {
 }
 
 std::string LoadStringFromGzip(const std::string &name) {
+    ProfileScope profile(hGroup{}, Profile::Phase::RESOURCES);
     size_t deflatedSize;
     const void *data = Platform::LoadResource(name, &deflatedSize);
 
@@ -61,6 +63,7 @@ std::string LoadStringFromGzip(const std::string &name) {
 }
 
 std::shared_ptr<Pixmap> LoadPng(const std::string &name) {
+    ProfileScope profile(hGroup{}, Profile::Phase::RESOURCES);
     size_t size;
     const void *data = Platform::LoadResource(name, &size);
 
@@ -665,7 +668,14 @@ size_t BitmapFont::GetWidth(const std::string &str) {
 }
 
 BitmapFont BitmapFont::Create() {
-    BitmapFont Font = BitmapFont::From(LoadStringFromGzip("fonts/unifont.hex.gz"));
+    // Every canvas has a font of its own, but inflating Unifont is by far
+    // the slowest part of making one; so do that only once.
+    static std::string unifontData;
+    if(unifontData.empty()) {
+        unifontData = LoadStringFromGzip("fonts/unifont.hex.gz");
+    }
+
+    BitmapFont Font = BitmapFont::From(std::string(unifontData));
     // Unifont doesn't have a glyph for U+0020.
     Font.AddGlyph(0x0020, Pixmap::Create(Pixmap::Format::RGB, 8, 16));
     Font.AddGlyph(0xE000, LoadPng("fonts/private/0-check-false.png"));
@@ -20,6 +20,7 @@ class Entity;
 class Param;
 class Equation;
 class Style;
+class LinkedSketch;
 
 enum class PolyError : uint32_t {
     GOOD              = 0,
@@ -179,6 +180,7 @@ public:
     double      scale;
 
     bool        clean;
+    uint64_t    fingerprint;    // of what we last generated from; see FingerprintGroups()
     bool        dofCheckOk;
     hEntity     activeWorkplane;
     double      valA;
@@ -192,6 +194,7 @@ public:
         int                 findToFixTimeout;
         bool                timeout;
         List<hConstraint>   remove;
+        SolveStats          stats;
     } solved;
 
     enum class Subtype : uint32_t {
@@ -249,14 +252,12 @@ public:
     };
     CombineAs meshCombine;
 
-    bool forceToMesh;
+    int forceToMesh; // not bool: it is saved as 'd', which reads and writes an int
 
     EntityMap remap;
 
     Platform::Path linkFile;
-    SMesh       impMesh;
-    SShell      impShell;
-    EntityList  impEntity;
+    std::shared_ptr<LinkedSketch> impLinked;
 
     std::string     name;
 
@@ -999,4 +1000,32 @@ public:
     hRequest    newReq;
 };
 
+// The geometry read from a linked file. All of the groups that link the same
+// (unchanged) file share a single one of these, and each applies its own
+// transformation as it generates; so it is never modified once loaded.
+class LinkedSketch {
+public:
+    Platform::Path      filename;
+    uint64_t            size;
+    int64_t             mtime;
+    uint64_t            hash;
+
+    EntityList          entity;
+    SMesh               mesh;
+    SShell              shell;
+    std::vector<Style>  style;
+    bool                loadError;
+
+    LinkedSketch() : size(0), mtime(0), hash(0), entity(), mesh(), shell(), loadError(false) {}
+    LinkedSketch(const LinkedSketch &) = delete;
+    LinkedSketch &operator=(const LinkedSketch &) = delete;
+    ~LinkedSketch() {
+        entity.Clear();
+        mesh.Clear();
+        shell.Clear();
+    }
+
+    bool ChangedOnDisk() const;
+};
+
 #endif
@@ -11,6 +11,8 @@ SolveSpaceUI SolveSpace::SS = {};
 Sketch SolveSpace::SK = {};
 
 void SolveSpaceUI::Init() {
+    ProfileScope profile(hGroup{}, Profile::Phase::INIT);
+
 #if !defined(HEADLESS)
     // Check that the resource system works.
     dbp("%s", LoadString("banner.txt").data());
@@ -82,12 +84,18 @@ void SolveSpaceUI::Init() {
     checkClosedContour = settings->ThawBool("CheckClosedContour", true);
     // Enable automatic constrains for lines
     automaticLineConstraints = settings->ThawBool("AutomaticLineConstraints", true);
+    // Cache the geometry of linked files beside them
+    cacheLinkedFiles = settings->ThawBool("CacheLinkedFiles", false);
+    // Compress saved files
+    compressSavedFiles = settings->ThawBool("CompressSavedFiles", false);
     // Draw closed polygons areas
     showContourAreas = settings->ThawBool("ShowContourAreas", false);
     // Export shaded triangles in a 2d view
     exportShadedTriangles = settings->ThawBool("ExportShadedTriangles", true);
     // Export pwl curves (instead of exact) always
     exportPwlCurves = settings->ThawBool("ExportPwlCurves", false);
+    // Quantize glTF mesh positions and normals
+    exportGltfQuantize = settings->ThawBool("ExportGltfQuantize", false);
     // Background color on-screen
     backgroundColor = settings->ThawColor("BackgroundColor", RGBi(0, 0, 0));
     // Whether export canvas size is fixed or derived from bbox
@@ -198,6 +206,8 @@ bool SolveSpaceUI::Load(const Platform::Path &filename) {
 }
 
 void SolveSpaceUI::Exit() {
+    FinishAutosave();
+
     Platform::SettingsRef settings = Platform::GetSettings();
 
     GW.window->FreezePosition(settings, "GraphicsWindow");
@@ -266,10 +276,16 @@ void SolveSpaceUI::Exit() {
     settings->FreezeBool("ImmediatelyEditDimension", immediatelyEditDimension);
     // Enable automatic constrains for lines
     settings->FreezeBool("AutomaticLineConstraints", automaticLineConstraints);
+    // Cache the geometry of linked files beside them
+    settings->FreezeBool("CacheLinkedFiles", cacheLinkedFiles);
+    // Compress saved files
+    settings->FreezeBool("CompressSavedFiles", compressSavedFiles);
     // Export shaded triangles in a 2d view
     settings->FreezeBool("ExportShadedTriangles", exportShadedTriangles);
     // Export pwl curves (instead of exact) always
     settings->FreezeBool("ExportPwlCurves", exportPwlCurves);
+    // Quantize glTF mesh positions and normals
+    settings->FreezeBool("ExportGltfQuantize", exportGltfQuantize);
     // Background color on-screen
     settings->FreezeColor("BackgroundColor", backgroundColor);
     // Whether export canvas size is fixed or derived from bbox
@@ -464,6 +480,10 @@ void SolveSpaceUI::AfterNewFile() {
     centerOfMass.draw = false;
     exportMode = false;
 
+    // and find the size of the new model from scratch, so that the chord
+    // tolerance doesn't depend on whatever was loaded before
+    chordTolExtent = 0.0;
+
     // GenerateAll() expects the view to be valid, because it uses that to
     // fill in default values for extrusion depths etc. (which won't matter
     // here, but just don't let it work on garbage)
@@ -537,12 +557,42 @@ void SolveSpaceUI::Autosave()
     ScheduleAutosave();
 
     if(!saveFile.IsEmpty() && unsaved) {
-        SaveToFile(saveFile.WithExtension(BACKUP_EXT));
+        FinishAutosave();
+
+        // Record the sketch just as undo would, which shares everything that
+        // hasn't changed since then and so is cheap, and write that out on
+        // another thread, so that a big sketch doesn't hold up the UI.
+        std::shared_ptr<UndoState> state = std::make_shared<UndoState>();
+        RecordCurrentState(state.get());
+        Platform::Path autosaveFile = saveFile.WithExtension(BACKUP_EXT);
+        bool compress = compressSavedFiles;
+        // The thread mustn't show an error itself; it leaves the file that it
+        // couldn't write for FinishAutosave() to report, after the join.
+        autosaveThread = std::thread([=] {
+            if(!SaveStateToFile(*state, autosaveFile, compress)) {
+                autosaveFailedFile = autosaveFile;
+            }
+            state->Clear();
+        });
+    }
+}
+
+// Wait for an autosave that's being written, so that it can't race with
+// anything else done to the autosave file; and tell the user if it failed.
+void SolveSpaceUI::FinishAutosave()
+{
+    if(autosaveThread.joinable()) {
+        autosaveThread.join();
+    }
+    if(!autosaveFailedFile.IsEmpty()) {
+        Error("Couldn't write to file '%s'", autosaveFailedFile.raw.c_str());
+        autosaveFailedFile.Clear();
     }
 }
 
 void SolveSpaceUI::RemoveAutosave()
 {
+    FinishAutosave();
     Platform::Path autosaveFile = saveFile.WithExtension(BACKUP_EXT);
     RemoveFile(autosaveFile);
 }
@@ -1019,11 +1069,13 @@ PACKAGE_VERSION, 2021);
 }
 
 void SolveSpaceUI::Clear() {
+    FinishAutosave();
     sys.Clear();
     for(int i = 0; i < MAX_UNDO; i++) {
         if(i < undo.cnt) undo.d[i].Clear();
         if(i < redo.cnt) redo.d[i].Clear();
     }
+    ClearGroupGeometry();
     TW.window = NULL;
     GW.openRecentMenu = NULL;
     GW.linkRecentMenu = NULL;
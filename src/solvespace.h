@@ -18,14 +18,18 @@
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <functional>
 #include <locale>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -91,6 +95,15 @@ void AssertFailure(const char *file, unsigned line, const char *function,
 __attribute__((__format__ (__printf__, 1, 2)))
 #endif
 std::string ssprintf(const char *fmt, ...);
+// Appends exactly what "%.<digits>f" would print, for 0 to 20 digits, but
+// much faster than printf().
+void AppendFixed(std::string *str, double v, int digits);
+// A JSON string literal, with quotes, for any UTF-8 string.
+std::string JsonString(const std::string &str);
+// Calls fn(i) for every i below count, on as many threads as there are cores;
+// fn must be safe to call from several threads at once. Temporaries that are
+// allocated by a call on another thread are freed when that thread ends.
+void ParallelFor(size_t count, const std::function<void(size_t)> &fn);
 
 inline bool IsReasonable(double x) {
     return std::isnan(x) || x > 1e11 || x < -1e11;
@@ -166,6 +179,22 @@ enum class SolveResult : uint32_t {
     TOO_MANY_UNKNOWNS        = 20
 };
 
+// What the solver did for one group, to find the sketches that are slow to
+// solve and why.
+struct SolveStats {
+    int         equations;          // left after substitution
+    int         unknowns;           // likewise
+    int         substituted;        // unknowns eliminated by substitution
+    int         alone;              // equations solved alone, before the rest
+    int         iterations;         // Newton iterations, over all of those
+    double      residual;           // of the last system, after iterating
+    int64_t     substitutionMicros;
+    int64_t     jacobianMicros;     // writing and evaluating the Jacobians
+    int64_t     rankTestMicros;
+    int64_t     linearSolveMicros;
+    bool        reused;             // solved again from kept Jacobians
+};
+
 
 #include "sketch.h"
 #include "ui.h"
@@ -203,9 +232,76 @@ void MakeMatrix(double *mat, double a11, double a12, double a13, double a14,
 void MultMatrix(double *mata, double *matb, double *matr);
 
 int64_t GetMilliseconds();
+int64_t GetMicroseconds();
+
+// Time and temporary allocations spent in each phase of regeneration, by
+// group. Nothing is recorded unless enabled; phases nest, and the time for
+// a phase includes that of any phases nested within it.
+class Profile {
+public:
+    enum class Phase : uint32_t {
+        GENERATE_ALL,
+        ENTITIES,
+        EQUATIONS,
+        JACOBIAN,
+        NEWTON,
+        RANK_TEST,
+        SOLVE,
+        SHELL_AND_MESH,
+        BOOLEAN,
+        TRIANGULATE,
+        DISPLAY_ITEMS,
+        INIT,
+        RESOURCES,
+        FONTS,
+        LOAD_FILE,
+    };
+
+    struct Entry {
+        hGroup      group;
+        Phase       phase;
+        uint64_t    count;
+        int64_t     micros;
+        uint64_t    allocations;
+        uint64_t    allocatedBytes;
+    };
+
+    static bool   enabled;
+    // The group being generated or solved, for phases that don't know it.
+    static hGroup currentGroup;
+
+    static void NameGroup(hGroup hg, const std::string &name);
+    static void Add(hGroup hg, Phase phase, int64_t micros,
+                    uint64_t allocations, uint64_t allocatedBytes);
+    static std::vector<Entry> GetEntries();
+    static void Clear();
+    static std::string ToJson(const std::string &source);
+    static const char *PhaseName(Phase phase);
+};
+
+class ProfileScope {
+public:
+    hGroup          group;
+    Profile::Phase  phase;
+    bool            active;
+    int64_t         startMicros;
+    uint64_t        startAllocations;
+    uint64_t        startAllocatedBytes;
+
+    ProfileScope(Profile::Phase phase) : ProfileScope(Profile::currentGroup, phase) {}
+    ProfileScope(hGroup hg, Profile::Phase phase);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
 void Message(const char *fmt, ...);
 void MessageAndRun(std::function<void()> onDismiss, const char *fmt, ...);
 void Error(const char *fmt, ...);
+// How many times Error() has been called, so that the caller of something
+// that reports its own errors can tell whether it failed.
+unsigned ErrorCount();
 
 class System {
 public:
@@ -219,6 +315,9 @@ public:
     // we should put as close as possible to their initial positions.
     List<hParam>                    dragged;
 
+    // Filled in by each solve.
+    SolveStats                      stats = {};
+
     enum {
         // In general, the tag indicates the subsys that a variable/equation
         // has been assigned to; these are exceptions for variables:
@@ -278,12 +377,41 @@ public:
 
     void MarkParamsFree(bool findFree);
     int CalculateDof();
+    void CountForStats();
+
+    // A Jacobian as written for one tag, copied out of the temporary arena,
+    // so that the same system can be solved again for new values of its
+    // params without writing its equations or taking any partials.
+    struct KeptJacobian {
+        int                     m, n;
+        std::vector<hEquation>  eq;
+        std::vector<hParam>     param;
+        std::vector<Expr *>     A;      // m rows of n
+        std::vector<Expr *>     B;
+        std::deque<Expr>        nodes;
+    };
+    bool                        keepJacobians = false;
+    // Indexed by tag; zero is the big system, the rest are solved alone.
+    std::vector<KeptJacobian>   kept;
+
+    void KeepJacobian(int tag);
+    void RestoreJacobian(int tag);
+
+    SolveResult SolveWritten(Group *g, int *rank, int *dof,
+                             List<hConstraint> *bad,
+                             bool andFindBad, bool andFindFree,
+                             bool forceDofCheck);
+    SolveResult DidntConverge(List<hConstraint> *bad, bool rankOk);
 
     SolveResult Solve(Group *g, int *rank = NULL, int *dof = NULL,
                       List<hConstraint> *bad = NULL,
                       bool andFindBad = false, bool andFindFree = false,
                       bool forceDofCheck = false);
 
+    SolveResult SolveAgain(Group *g, int *rank = NULL, int *dof = NULL,
+                           List<hConstraint> *bad = NULL,
+                           bool andFindBad = false, bool andFindFree = false);
+
     SolveResult SolveRank(Group *g, int *rank = NULL, int *dof = NULL,
                           List<hConstraint> *bad = NULL,
                           bool andFindBad = false, bool andFindFree = false);
@@ -506,28 +634,38 @@ public:
 #undef ENTITY
 #undef CONSTRAINT
 
+class SlvsReader;
+class SlvsWriter;
+
 class SolveSpaceUI {
 public:
     TextWindow                 *pTW;
     TextWindow                 &TW;
     GraphicsWindow              GW;
 
-    // The state for undo/redo
+    // The state for undo/redo. Each object is shared with the state that was
+    // recorded before it unless it changed in between, so that a state costs
+    // a pointer per object, plus a copy of whatever was actually edited. The
+    // objects are sorted by handle, as in the sketch.
     typedef struct UndoState {
-        IdList<Group,hGroup>            group;
-        List<hGroup>                    groupOrder;
-        IdList<Request,hRequest>        request;
-        IdList<Constraint,hConstraint>  constraint;
-        IdList<Param,hParam>            param;
-        IdList<Style,hStyle>            style;
-        hGroup                          activeGroup;
+        std::vector<std::shared_ptr<const Group>>       group;
+        List<hGroup>                                    groupOrder;
+        std::vector<std::shared_ptr<const Request>>     request;
+        std::vector<std::shared_ptr<const Constraint>>  constraint;
+        std::vector<std::shared_ptr<const Param>>       param;
+        std::vector<std::shared_ptr<const Style>>       style;
+        hGroup                                          activeGroup;
+        // Of what each group had generated when this state was recorded.
+        std::vector<uint64_t>                           fingerprints;
 
         void Clear() {
-            group.Clear();
-            request.Clear();
-            constraint.Clear();
-            param.Clear();
-            style.Clear();
+            fingerprints.clear();
+            group.clear();
+            groupOrder.Clear();
+            request.clear();
+            constraint.clear();
+            param.clear();
+            style.clear();
         }
     } UndoState;
     enum { MAX_UNDO = 100 };
@@ -538,6 +676,9 @@ public:
     } UndoStack;
     UndoStack   undo;
     UndoStack   redo;
+    // How many of the states on either stack have generated geometry with
+    // each fingerprint; only that geometry is worth keeping for an undo.
+    std::unordered_map<uint64_t, int> undoFingerprints;
 
     std::map<Platform::Path, std::shared_ptr<Pixmap>, Platform::PathLess> images;
     bool ReloadLinkedImage(const Platform::Path &saveFile, Platform::Path *filename,
@@ -547,9 +688,12 @@ public:
     void UndoRemember();
     void UndoUndo();
     void UndoRedo();
+    void RecordState(UndoState *ut, const UndoState *ref);
+    void RecordCurrentState(UndoState *ut);
     void PushFromCurrentOnto(UndoStack *uk);
     void PopOntoCurrentFrom(UndoStack *uk);
     void UndoClearState(UndoState *ut);
+    bool UndoMayRestore(uint64_t fingerprint);
     void UndoClearStack(UndoStack *uk);
 
     // Little bits of extra configuration state
@@ -560,6 +704,8 @@ public:
     double   ambientIntensity;
     double   chordTol;
     double   chordTolCalculated;
+    double   chordTolExtent;    // model size that chordTolCalculated is relative to
+    static const double CHORD_TOL_EXTENT_SLACK;
     int      maxSegments;
     double   exportChordTol;
     int      exportMaxSegments;
@@ -576,13 +722,20 @@ public:
     bool     turntableNav;
     bool     immediatelyEditDimension;
     bool     automaticLineConstraints;
+    bool     cacheLinkedFiles;
+    bool     compressSavedFiles;
     bool     showToolbar;
     Platform::Path screenshotFile;
     RgbaColor backgroundColor;
     bool     exportShadedTriangles;
     bool     exportPwlCurves;
+    bool     exportGltfQuantize;
     bool     exportCanvasSizeAuto;
     bool     exportMode;
+    // The export chord tolerance and segment limit that everything was last
+    // generated at for export, so that it's only regenerated if they change.
+    double   exportGeneratedChordTol;
+    int      exportGeneratedMaxSegments;
     struct {
         double  left;
         double  right;
@@ -636,7 +789,6 @@ public:
 
     // File load/save routines, including the additional files that get
     // loaded when we have link groups.
-    FILE        *fh;
     void AfterNewFile();
     void AddToRecentList(const Platform::Path &filename);
     Platform::Path saveFile;
@@ -649,9 +801,14 @@ public:
         void       *ptr;
     } SaveTable;
     static const SaveTable SAVED[];
-    void SaveUsingTable(const Platform::Path &filename, int type);
-    void LoadUsingTable(const Platform::Path &filename, char *key, char *val);
-    struct {
+    static void SaveUsingTable(SlvsWriter *w, const Platform::Path &filename, int type,
+                               const void *obj);
+    static int FindSavedByKey(const char *key, size_t length);
+    static bool SavedFieldsEqual(int type, const void *a, const void *b);
+    static uint64_t HashSavedFields(int type, const void *obj, uint64_t h);
+    // The record being read or written; SAVED[] points into sv, but the
+    // same fields can be found in any other SaveData.
+    struct SaveData {
         Group        g;
         Request      r;
         Entity       e;
@@ -659,8 +816,12 @@ public:
         Constraint   c;
         Style        s;
     } sv;
+    bool LoadUsingTable(const Platform::Path &filename, SlvsReader *reader, SaveData *data);
+    static bool SaveStateToFile(const UndoState &state, const Platform::Path &filename,
+                                bool compress);
     static void MenuFile(Command id);
     void Autosave();
+    void FinishAutosave();
     void RemoveAutosave();
     static constexpr size_t MAX_RECENT = 8;
     static constexpr const char *SKETCH_EXT = "slvs";
@@ -677,12 +838,17 @@ public:
     bool LoadAutosaveFor(const Platform::Path &filename);
     bool LoadFromFile(const Platform::Path &filename, bool canCancel = false);
     void UpgradeLegacyData();
-    bool LoadEntitiesFromFile(const Platform::Path &filename, EntityList *le,
-                              SMesh *m, SShell *sh);
-    bool LoadEntitiesFromSlvs(const Platform::Path &filename, EntityList *le,
-                              SMesh *m, SShell *sh);
+    bool LoadEntitiesFromFile(const Platform::Path &filename, LinkedSketch *ls);
+    std::shared_ptr<LinkedSketch> LoadLinkedSketch(const Platform::Path &filename);
+    bool LoadLinkedCache(const Platform::Path &filename, const Platform::MappedFile &source,
+                         LinkedSketch *ls);
+    void SaveLinkedCache(const Platform::Path &filename, const Platform::MappedFile &source,
+                         LinkedSketch *ls);
+    bool LoadEntitiesFromSlvs(const Platform::Path &filename, LinkedSketch *ls);
     bool ReloadAllLinked(const Platform::Path &filename, bool canCancel = false);
+    bool ReloadChangedLinked(Group *g);
     // And the various export options
+    void GenerateForExport();
     void ExportAsPngTo(const Platform::Path &filename);
     void ExportMeshTo(const Platform::Path &filename);
     void ExportMeshAsStlTo(FILE *f, SMesh *sm);
@@ -690,6 +856,7 @@ public:
     void ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename,
                                SMesh *sm, SOutlineList *sol);
     void ExportMeshAsVrmlTo(FILE *f, const Platform::Path &filename, SMesh *sm);
+    void ExportMeshAsGltfTo(FILE *f, SMesh *sm);
     void ExportViewOrWireframeTo(const Platform::Path &filename, bool exportWireframe);
     void ExportSectionTo(const Platform::Path &filename);
     void ExportWireframeCurves(SEdgeList *sel, SBezierList *sbl,
@@ -761,6 +928,11 @@ public:
         UNTIL_ACTIVE,
     };
 
+    void FingerprintGroups(std::map<uint32_t, uint64_t> *fingerprints);
+    void StashGroupGeometry(Group *g);
+    bool RestoreGroupGeometry(Group *g, uint64_t fingerprint);
+    size_t StashedGroupGeometryCount();
+    void ClearGroupGeometry();
     void GenerateAll(Generate type = Generate::DIRTY, bool andFindFree = false,
                      bool genForBBox = false);
     void SolveGroup(hGroup hg, bool andFindFree);
@@ -788,6 +960,8 @@ public:
     Platform::TimerRef showTWTimer;
     Platform::TimerRef generateAllTimer;
     Platform::TimerRef autosaveTimer;
+    std::thread autosaveThread;
+    Platform::Path autosaveFailedFile;
     void ScheduleShowTW();
     void ScheduleGenerateAll();
     void ScheduleAutosave();
@@ -804,6 +978,11 @@ public:
           pSys(new System()), sys(*pSys) {}
 
     ~SolveSpaceUI() {
+        // A thread that's still joinable when destroyed terminates us, and we
+        // may get here without Exit(); there's no one to tell of a failure.
+        if(autosaveThread.joinable()) {
+            autosaveThread.join();
+        }
         delete pTW;
         delete pSys;
     }
@@ -814,7 +993,12 @@ void ImportDwg(const Platform::Path &file);
 bool LinkIDF(const Platform::Path &filename, EntityList *le, SMesh *m, SShell *sh);
 
 extern SolveSpaceUI SS;
+#if defined(LIBRARY)
+// Each thread has a sketch of its own, so that several can solve at once.
+extern thread_local Sketch SK;
+#else
 extern Sketch SK;
+#endif
 
 }
 
@@ -6,6 +6,8 @@
 //-----------------------------------------------------------------------------
 #include "solvespace.h"
 
+#include <random>
+
 static int I;
 
 void SShell::MakeFromUnionOf(SShell *a, SShell *b) {
@@ -694,6 +696,9 @@ void SShell::CopySurfacesTrimAgainst(SShell *sha, SShell *shb, SShell *into, SSu
 #pragma omp parallel for
     for (int i = 0; i < surface.n; i++)
     {
+        // Per surface, since temporary arenas belong to the thread that does
+        // the work; the BSP of the original trim doesn't outlive the copy.
+        Platform::TemporaryScope scope("SShell::CopySurfacesTrimAgainst");
         SSurface *ss = &surface[i];
         ssn[i] = ss->MakeCopyTrimAgainst(this, sha, shb, into, type, i);
     }
@@ -790,6 +795,11 @@ void SShell::MakeFromAssemblyOf(SShell *a, SShell *b) {
 }
 
 void SShell::MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type) {
+    // Whatever this thread allocates as scratch dies with this operation.
+    // The parallel loops below run on other threads too, with temporary
+    // arenas of their own, so each of those opens a scope per iteration.
+    Platform::TemporaryScope scope("SShell::MakeFromBoolean");
+
     booleanFailed = false;
 
     a->MakeClassifyingBsps(NULL);
@@ -845,15 +855,50 @@ void SShell::MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type) {
 void SShell::MakeClassifyingBsps(SShell *useCurvesFrom) {
 #pragma omp parallel for
     for(int i = 0; i<surface.n; i++) {
+        // Per surface, as above; the tree is flattened onto the heap before
+        // the scope ends.
+        Platform::TemporaryScope scope("SShell::MakeClassifyingBsps");
         surface[i].MakeClassifyingBsp(this, useCurvesFrom);
     }
 }
 
+//-----------------------------------------------------------------------------
+// A hash of everything that our classifying BSP depends upon: the trim edges
+// in uv space, and the surface itself, since distances are scaled by its
+// tangents. If that's unchanged since we last built the BSP, then we can
+// reuse it.
+//-----------------------------------------------------------------------------
+static uint64_t HashBytes(uint64_t h, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    for(size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+static uint64_t HashForClassifyingBsp(const SSurface *srf, const SEdgeList *el) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    h = HashBytes(h, &srf->degm, sizeof(srf->degm));
+    h = HashBytes(h, &srf->degn, sizeof(srf->degn));
+    h = HashBytes(h, srf->ctrl, sizeof(srf->ctrl));
+    h = HashBytes(h, srf->weight, sizeof(srf->weight));
+    for(const SEdge &se : el->l) {
+        h = HashBytes(h, &se.a, sizeof(se.a));
+        h = HashBytes(h, &se.b, sizeof(se.b));
+    }
+    return h;
+}
+
 void SSurface::MakeClassifyingBsp(SShell *shell, SShell *useCurvesFrom) {
     SEdgeList el = {};
 
     MakeEdgesInto(shell, &el, MakeAs::UV, useCurvesFrom);
-    bsp = SBspUv::From(&el, this);
+    uint64_t hash = HashForClassifyingBsp(this, &el);
+    if(!bspNodes || bspHash != hash) {
+        bspNodes = SBspUv::Flatten(SBspUv::From(&el, this));
+        bspHash  = hash;
+    }
+    bsp = bspNodes->empty() ? NULL : &(*bspNodes)[0];
     el.Clear();
 
     edges = {};
@@ -871,12 +916,30 @@ SBspUv *SBspUv::From(SEdgeList *el, SSurface *srf) {
     for(se = el->l.First(); se; se = el->l.NextAfter(se)) {
         work.AddEdge(se->a, se->b, se->auxA, se->auxB);
     }
-    std::sort(work.l.begin(), work.l.end(), [](SEdge const &a, SEdge const &b) {
-        double la = (a.a).Minus(a.b).Magnitude(), lb = (b.a).Minus(b.b).Magnitude();
+    auto Length = [](SEdge const &e) { return (e.a).Minus(e.b).Magnitude(); };
+    std::stable_sort(work.l.begin(), work.l.end(), [&](SEdge const &a, SEdge const &b) {
         // Sort in descending order, longest first. This improves numerical
         // stability for the normals.
-        return la > lb;
+        return Length(a) > Length(b);
     });
+    // But a contour is often many edges of about the same length (a circle,
+    // say), and inserting those in order around it makes a tree that's just
+    // about a linked list. So shuffle the edges within each octave of length,
+    // which still puts the long ones first, and gives a tree of expected
+    // logarithmic depth. We do our own Fisher-Yates shuffle with a fixed seed,
+    // since std::shuffle differs between standard libraries and the tree
+    // should be the same on every platform.
+    std::minstd_rand rng(1);
+    for(int start = 0, end; start < work.l.n; start = end) {
+        int octave = ilogb(Length(work.l[start]));
+        for(end = start + 1; end < work.l.n; end++) {
+            if(ilogb(Length(work.l[end])) != octave) break;
+        }
+        for(int i = end - 1; i > start; i--) {
+            int j = start + (int)(rng() % (uint32_t)(i - start + 1));
+            swap(work.l[i], work.l[j]);
+        }
+    }
     SBspUv *bsp = NULL;
     for(se = work.l.First(); se; se = work.l.NextAfter(se)) {
         bsp = InsertOrCreateEdge(bsp, (se->a).ProjectXy(), (se->b).ProjectXy(), srf);
@@ -886,6 +949,41 @@ SBspUv *SBspUv::From(SEdgeList *el, SSurface *srf) {
     return bsp;
 }
 
+//-----------------------------------------------------------------------------
+// Copy a BSP out of the temporary arena into a single block of storage, in
+// depth-first order, so that it can be kept for as long as we want and walked
+// without chasing pointers all over the heap.
+//-----------------------------------------------------------------------------
+static size_t CountBspUvNodes(const SBspUv *bsp) {
+    if(bsp == NULL) return 0;
+    return 1 + CountBspUvNodes(bsp->more) +
+               CountBspUvNodes(bsp->pos) + CountBspUvNodes(bsp->neg);
+}
+
+static SBspUv *CopyBspUvInto(const SBspUv *bsp, std::vector<SBspUv> *nodes) {
+    if(bsp == NULL) return NULL;
+
+    nodes->push_back(*bsp);
+    size_t i = nodes->size() - 1;
+    SBspUv *more = CopyBspUvInto(bsp->more, nodes);
+    SBspUv *pos  = CopyBspUvInto(bsp->pos,  nodes);
+    SBspUv *neg  = CopyBspUvInto(bsp->neg,  nodes);
+
+    SBspUv *n = &(*nodes)[i];
+    n->more = more;
+    n->pos  = pos;
+    n->neg  = neg;
+    return n;
+}
+
+std::shared_ptr<std::vector<SBspUv>> SBspUv::Flatten(SBspUv *root) {
+    std::shared_ptr<std::vector<SBspUv>> nodes = std::make_shared<std::vector<SBspUv>>();
+    // Reserve exactly, so that the pointers between nodes stay valid.
+    nodes->reserve(CountBspUvNodes(root));
+    CopyBspUvInto(root, nodes.get());
+    return nodes;
+}
+
 //-----------------------------------------------------------------------------
 // The points in this BSP are in uv space, but we want to apply our tolerances
 // consistently in xyz (i.e., we want to say a point is on-edge if its xyz
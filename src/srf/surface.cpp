@@ -487,6 +487,8 @@ void SSurface::ScaleSelfBy(double s) {
 
 void SSurface::Clear() {
     trim.Clear();
+    bspNodes.reset();
+    bsp = NULL;
 }
 
 typedef struct {
@@ -1070,6 +1072,9 @@ void SShell::MakeSectionEdgesInto(Vector n, double d, SEdgeList *sel, SBezierLis
 void SShell::TriangulateInto(SMesh *sm) {
 #pragma omp parallel for
     for(int i=0; i<surface.n; i++) {
+        // Per surface, since temporary arenas belong to the thread that
+        // does the work; nothing but the heap-allocated mesh escapes.
+        Platform::TemporaryScope scope("SShell::TriangulateInto");
         SSurface *s = &surface[i];
         SMesh m;
         s->TriangulateInto(this, &m);
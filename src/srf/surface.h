@@ -35,6 +35,7 @@ public:
 
     static SBspUv *Alloc();
     static SBspUv *From(SEdgeList *el, SSurface *srf);
+    static std::shared_ptr<std::vector<SBspUv>> Flatten(SBspUv *root);
 
     void ScalePoints(Point2d *pt, Point2d *a, Point2d *b, SSurface *srf) const;
     double ScaledSignedDistanceToLine(Point2d pt, Point2d a, Point2d b,
@@ -279,6 +280,10 @@ public:
     // For testing whether a point (u, v) on the surface lies inside the trim
     SBspUv          *bsp;
     SEdgeList       edges;
+    // The storage for bsp, which outlives the temporary arena so that it can
+    // be reused for as long as the trim (and the surface itself) is unchanged.
+    std::shared_ptr<std::vector<SBspUv>> bspNodes;
+    uint64_t        bspHash;
 
     // For caching our initial (u, v) when doing Newton iterations to project
     // a point into our surface.
@@ -709,6 +709,8 @@ void SPolygon::UvGridTriangulateInto(SMesh *mesh, SSurface *srf) {
 }
 
 void SPolygon::TriangulateInto(SMesh *m) const {
+    Platform::TemporaryScope scope("SPolygon::TriangulateInto");
+
     Vector n = normal;
     if(n.Equals(Vector::From(0.0, 0.0, 0.0))) {
        n = ComputeNormal();
@@ -19,7 +19,19 @@ const double System::RANK_MAG_TOLERANCE = 1e-4;
 // always be much less than LENGTH_EPS, and in practice should be much less.
 const double System::CONVERGE_TOLERANCE = (LENGTH_EPS/(1e2));
 
+// Adds the time for which it's alive to one of the totals in the stats.
+class StatsTimer {
+public:
+    int64_t *total;
+    int64_t  start;
+
+    StatsTimer(int64_t *total) : total(total), start(GetMicroseconds()) {}
+    ~StatsTimer() { *total += GetMicroseconds() - start; }
+};
+
 bool System::WriteJacobian(int tag) {
+    ProfileScope profile(Profile::Phase::JACOBIAN);
+    StatsTimer timer(&stats.jacobianMicros);
 
     int j = 0;
     for(auto &p : param) {
@@ -69,6 +81,8 @@ bool System::WriteJacobian(int tag) {
 }
 
 void System::EvalJacobian() {
+    StatsTimer timer(&stats.jacobianMicros);
+
     int i, j;
     for(i = 0; i < mat.m; i++) {
         for(j = 0; j < mat.n; j++) {
@@ -167,7 +181,10 @@ int System::CalculateRank() {
 }
 
 bool System::TestRank(int *rank) {
+    ProfileScope profile(Profile::Phase::RANK_TEST);
+
     EvalJacobian();
+    StatsTimer timer(&stats.rankTestMicros);
     int jacobianRank = CalculateRank();
     if(rank) *rank = jacobianRank;
     return jacobianRank == mat.m;
@@ -230,6 +247,8 @@ bool System::SolveLinearSystem(double X[], double A[][MAX_UNKNOWNS],
 }
 
 bool System::SolveLeastSquares() {
+    StatsTimer timer(&stats.linearSolveMicros);
+
     int r, c, i;
 
     // Scale the columns; this scale weights the parameters for the least
@@ -273,6 +292,7 @@ bool System::SolveLeastSquares() {
 }
 
 bool System::NewtonSolve(int tag) {
+    ProfileScope profile(Profile::Phase::NEWTON);
 
     int iter = 0;
     bool converged = false;
@@ -287,6 +307,7 @@ bool System::NewtonSolve(int tag) {
         EvalJacobian();
 
         if(!SolveLeastSquares()) break;
+        stats.iterations++;
 
         // Take the Newton step;
         //      J(x_n) (x_{n+1} - x_n) = 0 - F(x_n)
@@ -316,10 +337,18 @@ bool System::NewtonSolve(int tag) {
         }
     } while(iter++ < 50 && !converged);
 
+    double sumSquares = 0;
+    for(i = 0; i < mat.m; i++) {
+        sumSquares += mat.B.num[i]*mat.B.num[i];
+    }
+    stats.residual = sqrt(sumSquares);
+
     return converged;
 }
 
 void System::WriteEquationsExceptFor(hConstraint hc, Group *g) {
+    ProfileScope profile(Profile::Phase::EQUATIONS);
+
     // Generate all the equations from constraints in this group
     for(auto &con : SK.constraint) {
         ConstraintBase *c = &con;
@@ -400,33 +429,85 @@ void System::FindWhichToRemoveToFixJacobian(Group *g, List<hConstraint> *bad, bo
     }
 }
 
+void System::KeepJacobian(int tag) {
+    if((int)kept.size() <= tag) kept.resize(tag + 1);
+    KeptJacobian *kj = &kept[tag];
+    kj->m = mat.m;
+    kj->n = mat.n;
+    kj->eq.assign(mat.eq, mat.eq + mat.m);
+    kj->param.assign(mat.param, mat.param + mat.n);
+    kj->A.clear();
+    kj->B.clear();
+    kj->nodes.clear();
+
+    // The partials share subexpressions, and every zero is the same node, so
+    // copy each node once; the deque never moves what it already holds.
+    std::unordered_map<const Expr *, Expr *> copied;
+    std::function<Expr *(const Expr *)> copy = [&](const Expr *e) -> Expr * {
+        auto it = copied.find(e);
+        if(it != copied.end()) return it->second;
+        kj->nodes.push_back(*e);
+        Expr *n = &kj->nodes.back();
+        int c = n->Children();
+        if(c > 0) n->a = copy(e->a);
+        if(c > 1) n->b = copy(e->b);
+        copied[e] = n;
+        return n;
+    };
+
+    int i, j;
+    for(i = 0; i < mat.m; i++) {
+        for(j = 0; j < mat.n; j++) {
+            kj->A.push_back(copy(mat.A.sym[i][j]));
+        }
+        kj->B.push_back(copy(mat.B.sym[i]));
+    }
+}
+
+void System::RestoreJacobian(int tag) {
+    const KeptJacobian &kj = kept[tag];
+    mat.m = kj.m;
+    mat.n = kj.n;
+    std::copy(kj.eq.begin(), kj.eq.end(), mat.eq);
+    std::copy(kj.param.begin(), kj.param.end(), mat.param);
+
+    int i, j;
+    for(i = 0; i < mat.m; i++) {
+        for(j = 0; j < mat.n; j++) {
+            mat.A.sym[i][j] = kj.A[i*mat.n + j];
+        }
+        mat.B.sym[i] = kj.B[i];
+    }
+}
+
 SolveResult System::Solve(Group *g, int *rank, int *dof, List<hConstraint> *bad,
                           bool andFindBad, bool andFindFree, bool forceDofCheck)
 {
+    stats = {};
     WriteEquationsExceptFor(Constraint::NO_CONSTRAINT, g);
 
-    int i;
-    bool rankOk;
-
 /*
     dbp("%d equations", eq.n);
-    for(i = 0; i < eq.n; i++) {
+    for(int i = 0; i < eq.n; i++) {
         dbp("  %.3f = %s = 0", eq[i].e->Eval(), eq[i].e->Print());
     }
     dbp("%d parameters", param.n);
-    for(i = 0; i < param.n; i++) {
+    for(int i = 0; i < param.n; i++) {
         dbp("   param %08x at %.3f", param[i].h.v, param[i].val);
     } */
 
     // All params and equations are assigned to group zero.
     param.ClearTags();
     eq.ClearTags();
+    kept.clear();
 
     // Solving by substitution eliminates duplicate e.g. H/V constraints, which can cause rank test
     // to succeed even on overdefined systems, which will fail later.
     if(!forceDofCheck) {
+        StatsTimer timer(&stats.substitutionMicros);
         SolveBySubstitution();
     }
+    CountForStats();
 
     // Before solving the big system, see if we can find any equations that
     // are soluble alone. This can be a huge speedup. We don't know whether
@@ -447,14 +528,14 @@ SolveResult System::Solve(Group *g, int *rank, int *dof, List<hConstraint> *bad,
         e.tag  = alone;
         p->tag = alone;
         WriteJacobian(alone);
+        if(keepJacobians) KeepJacobian(alone);
         if(!NewtonSolve(alone)) {
             // We don't do the rank test, so let's arbitrarily return
             // the DIDNT_CONVERGE result here.
-            rankOk = true;
-            // Failed to converge, bail out early
-            goto didnt_converge;
+            return DidntConverge(bad, /*rankOk=*/true);
         }
         alone++;
+        stats.alone++;
     }
 
     // Now write the Jacobian for what's left, and do a rank test; that
@@ -462,12 +543,52 @@ SolveResult System::Solve(Group *g, int *rank, int *dof, List<hConstraint> *bad,
     if(!WriteJacobian(0)) {
         return SolveResult::TOO_MANY_UNKNOWNS;
     }
+    if(keepJacobians) KeepJacobian(0);
 
-    rankOk = TestRank(rank);
+    return SolveWritten(g, rank, dof, bad, andFindBad, andFindFree, forceDofCheck);
+}
+
+//-----------------------------------------------------------------------------
+// Solve the system again after only the values of its params have changed,
+// starting from the Jacobians that the last Solve() kept; the equations, the
+// substitutions and the tags all stay as that left them. Only valid if that
+// solve succeeded, since finding what's bad rewrites the equations.
+//-----------------------------------------------------------------------------
+SolveResult System::SolveAgain(Group *g, int *rank, int *dof, List<hConstraint> *bad,
+                               bool andFindBad, bool andFindFree)
+{
+    ssassert(!kept.empty(), "Expected a kept Jacobian");
+
+    // The system is the same size as before, but all the work is new.
+    SolveStats last = stats;
+    stats = {};
+    stats.equations   = last.equations;
+    stats.unknowns    = last.unknowns;
+    stats.substituted = last.substituted;
+    stats.alone       = last.alone;
+    stats.reused      = true;
+
+    int tag;
+    for(tag = 1; tag < (int)kept.size(); tag++) {
+        RestoreJacobian(tag);
+        if(!NewtonSolve(tag)) {
+            return DidntConverge(bad, /*rankOk=*/true);
+        }
+    }
+
+    RestoreJacobian(0);
+    return SolveWritten(g, rank, dof, bad, andFindBad, andFindFree,
+                        /*forceDofCheck=*/false);
+}
+
+SolveResult System::SolveWritten(Group *g, int *rank, int *dof, List<hConstraint> *bad,
+                                 bool andFindBad, bool andFindFree, bool forceDofCheck)
+{
+    bool rankOk = TestRank(rank);
 
     // And do the leftovers as one big system
     if(!NewtonSolve(0)) {
-        goto didnt_converge;
+        return DidntConverge(bad, rankOk);
     }
 
     rankOk = TestRank(rank);
@@ -495,11 +616,12 @@ SolveResult System::Solve(Group *g, int *rank, int *dof, List<hConstraint> *bad,
         pp->free  = p.free;
     }
     return rankOk ? SolveResult::OKAY : SolveResult::REDUNDANT_OKAY;
+}
 
-didnt_converge:
+SolveResult System::DidntConverge(List<hConstraint> *bad, bool rankOk) {
     SK.constraint.ClearTags();
     // Not using range-for here because index is used in additional ways
-    for(i = 0; i < eq.n; i++) {
+    for(int i = 0; i < eq.n; i++) {
         if(fabs(mat.B.num[i]) > CONVERGE_TOLERANCE || IsReasonable(mat.B.num[i])) {
             // This constraint is unsatisfied.
             if(!mat.eq[i].isFromConstraint()) continue;
@@ -522,11 +644,13 @@ didnt_converge:
 SolveResult System::SolveRank(Group *g, int *rank, int *dof, List<hConstraint> *bad,
                               bool andFindBad, bool andFindFree)
 {
+    stats = {};
     WriteEquationsExceptFor(Constraint::NO_CONSTRAINT, g);
 
     // All params and equations are assigned to group zero.
     param.ClearTags();
     eq.ClearTags();
+    CountForStats();
 
     // Now write the Jacobian, and do a rank test; that
     // tells us if the system is inconsistently constrained.
@@ -544,11 +668,28 @@ SolveResult System::SolveRank(Group *g, int *rank, int *dof, List<hConstraint> *
     return rankOk ? SolveResult::OKAY : SolveResult::REDUNDANT_OKAY;
 }
 
+void System::CountForStats() {
+    stats.equations   = 0;
+    stats.unknowns    = 0;
+    stats.substituted = 0;
+    for(const Equation &e : eq) {
+        if(e.tag != EQ_SUBSTITUTED) stats.equations++;
+    }
+    for(const Param &p : param) {
+        if(p.tag == VAR_SUBSTITUTED) {
+            stats.substituted++;
+        } else {
+            stats.unknowns++;
+        }
+    }
+}
+
 void System::Clear() {
     entity.Clear();
     param.Clear();
     eq.Clear();
     dragged.Clear();
+    kept.clear();
 }
 
 void System::MarkParamsFree(bool find) {
@@ -516,6 +516,20 @@ list_items:
         }
     }
     if(a == 0) Printf(false, "%Ba   (none)");
+
+    const SolveStats &st = g->solved.stats;
+    Printf(false, "");
+    Printf(false, "%Ft last solve");
+    Printf(false, "   %d equations in %d unknowns", st.equations, st.unknowns);
+    Printf(false, "   %d substituted, %d solved alone", st.substituted, st.alone);
+    Printf(false, "   %d Newton iterations, residual %s", st.iterations,
+           ssprintf("%.3g", st.residual).c_str());
+    Printf(false, "   substitution %s ms, Jacobian %s ms",
+           ssprintf("%.3f", st.substitutionMicros / 1000.0).c_str(),
+           ssprintf("%.3f", st.jacobianMicros / 1000.0).c_str());
+    Printf(false, "   rank test %s ms, linear solves %s ms",
+           ssprintf("%.3f", st.rankTestMicros / 1000.0).c_str(),
+           ssprintf("%.3f", st.linearSolveMicros / 1000.0).c_str());
 }
 
 //-----------------------------------------------------------------------------
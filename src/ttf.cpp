@@ -45,34 +45,157 @@ extern "C" const char *ft_error_string(int err) {
 // Get the list of available font filenames, and load the name for each of
 // them. Only that, though, not the glyphs too.
 //-----------------------------------------------------------------------------
+static const char *BUILTIN_FONT = "fonts/BitstreamVeraSans-Roman-builtin.ttf";
+
 TtfFontList::TtfFontList() {
     FT_Init_FreeType(&fontLibrary);
+    loaded = false;
+    listed = false;
 }
 
 TtfFontList::~TtfFontList() {
     FT_Done_FreeType(fontLibrary);
 }
 
+const std::vector<Platform::Path> &TtfFontList::FontFiles() {
+    if(!listed) {
+        fontFiles = Platform::GetFontFiles();
+        listed = true;
+    }
+    return fontFiles;
+}
+
+//-----------------------------------------------------------------------------
+// Finding out the name of a font means opening it, and there may be hundreds
+// of them; so the names are kept on disk, one font per line, as the path,
+// size, modification time and name separated by tabs. A font that could not
+// be loaded is kept too, with an empty name, so that it isn't tried again.
+//-----------------------------------------------------------------------------
+struct FontCacheEntry {
+    uint64_t    size;
+    int64_t     mtime;
+    std::string name;
+};
+
+typedef std::map<std::string, FontCacheEntry> FontCache;
+
+static const char *FONT_CACHE_HEADER = "SolveSpace font cache 1";
+
+static Platform::Path FontCachePath() {
+    Platform::Path cacheDir = Platform::CacheDirectory();
+    if(cacheDir.IsEmpty()) return cacheDir;
+    return cacheDir.Join("fonts.txt");
+}
+
+static FontCache ReadFontCache(const Platform::Path &filename) {
+    FontCache cache;
+    std::string data;
+    if(filename.IsEmpty() || !Platform::ReadFile(filename, &data)) return cache;
+
+    size_t pos = data.find('\n');
+    if(pos == std::string::npos || data.compare(0, pos, FONT_CACHE_HEADER) != 0) {
+        return cache;
+    }
+    while(++pos < data.size()) {
+        size_t eol = data.find('\n', pos);
+        if(eol == std::string::npos) break;
+        std::string line = data.substr(pos, eol - pos);
+        pos = eol;
+
+        size_t tab1 = line.find('\t'),
+               tab2 = line.find('\t', tab1 + 1),
+               tab3 = line.find('\t', tab2 + 1);
+        if(tab1 == std::string::npos || tab2 == std::string::npos ||
+                tab3 == std::string::npos) continue;
+
+        FontCacheEntry entry = {};
+        entry.size  = strtoull(line.substr(tab1 + 1, tab2 - tab1 - 1).c_str(), NULL, 10);
+        entry.mtime = strtoll(line.substr(tab2 + 1, tab3 - tab2 - 1).c_str(), NULL, 10);
+        entry.name  = line.substr(tab3 + 1);
+        cache[line.substr(0, tab1)] = entry;
+    }
+    return cache;
+}
+
+static void WriteFontCache(const Platform::Path &filename, const FontCache &cache) {
+    if(filename.IsEmpty()) return;
+
+    std::string data = FONT_CACHE_HEADER;
+    data += "\n";
+    for(const auto &it : cache) {
+        data += ssprintf("%s\t%llu\t%lld\t%s\n", it.first.c_str(),
+                         (unsigned long long)it.second.size, (long long)it.second.mtime,
+                         it.second.name.c_str());
+    }
+
+    // Write a new file and move it over the old one, so that another instance
+    // loading the cache at the same time never sees half of it.
+    Platform::Path tempFile = filename.WithExtension("tmp");
+    if(!Platform::WriteFile(tempFile, data) || !Platform::RenameFile(tempFile, filename)) {
+        dbp("cannot write font cache '%s'", filename.raw.c_str());
+        Platform::RemoveFile(tempFile);
+    }
+}
+
 void TtfFontList::LoadAll() {
     if(loaded) return;
+    ProfileScope profile(hGroup{}, Profile::Phase::FONTS);
+
+    // Fonts that were already opened by LoadFont stay as they are.
+    auto isListed = [&](const Platform::Path &fontFile) {
+        return std::find_if(l.begin(), l.end(), [&](const TtfFont &tf) {
+            return tf.fontFile.raw == fontFile.raw;
+        }) != l.end();
+    };
+
+    Platform::Path cacheFile = FontCachePath();
+    FontCache cache = ReadFontCache(cacheFile),
+              newCache;
+    bool cacheChanged = false;
+    for(const Platform::Path &font : FontFiles()) {
+        if(font.raw.find_first_of("\t\n") != std::string::npos) continue;
+        if(isListed(font)) continue;
 
-    for(const Platform::Path &font : Platform::GetFontFiles()) {
         TtfFont tf = {};
         tf.fontFile = font;
-        if(tf.LoadFromFile(fontLibrary))
+
+        FontCacheEntry entry = {};
+        bool stamped = Platform::StatFile(font, &entry.size, &entry.mtime);
+        auto it = cache.find(font.raw);
+        if(stamped && it != cache.end() &&
+                it->second.size == entry.size && it->second.mtime == entry.mtime) {
+            entry.name = it->second.name;
+        } else {
+            if(tf.LoadFromFile(fontLibrary)) {
+                entry.name = tf.name;
+            }
+            cacheChanged = true;
+        }
+        if(stamped) {
+            newCache[font.raw] = entry;
+        }
+
+        if(!entry.name.empty()) {
+            tf.name = entry.name;
             l.Add(&tf);
+        }
+    }
+    if(cacheChanged || newCache.size() != cache.size()) {
+        WriteFontCache(cacheFile, newCache);
     }
 
     // Add builtin font to end of font list so it is displayed first in the UI
     {
         TtfFont tf = {};
-        tf.SetResourceID("fonts/BitstreamVeraSans-Roman-builtin.ttf");
-        if(tf.LoadFromResource(fontLibrary))
+        tf.SetResourceID(BUILTIN_FONT);
+        if(!isListed(tf.fontFile) && tf.LoadFromResource(fontLibrary))
             l.Add(&tf);
     }
 
-    // Sort fonts according to their actual name, not filename.
-    std::sort(l.begin(), l.end(),
+    // Sort fonts according to their actual name, not filename. The sort is
+    // stable, so that of fonts with the same name, any that were already
+    // opened come first, and are the ones kept below.
+    std::stable_sort(l.begin(), l.end(),
         [](const TtfFont &a, const TtfFont &b) { return a.name < b.name; });
 
     // Filter out fonts with the same family and style name. This is not
@@ -87,10 +210,32 @@ void TtfFontList::LoadAll() {
     loaded = true;
 }
 
+//-----------------------------------------------------------------------------
+// Open just the one font with the given filename, without finding out the
+// names of all the others; that's all a sketch that uses the font needs.
+//-----------------------------------------------------------------------------
+TtfFont *TtfFontList::OpenFont(const std::string &font) {
+    ProfileScope profile(hGroup{}, Profile::Phase::FONTS);
+
+    TtfFont tf = {};
+    tf.SetResourceID(BUILTIN_FONT);
+    if(tf.FontFileBaseName() == font) {
+        if(!tf.LoadFromResource(fontLibrary, /*keepOpen=*/true)) return NULL;
+    } else {
+        auto fontFile = std::find_if(FontFiles().begin(), FontFiles().end(),
+            [&font](const Platform::Path &fontFile) { return fontFile.FileName() == font; });
+        if(fontFile == FontFiles().end()) return NULL;
+
+        tf.fontFile = *fontFile;
+        if(!tf.LoadFromFile(fontLibrary, /*keepOpen=*/true)) return NULL;
+    }
+
+    l.Add(&tf);
+    return &l[l.n - 1];
+}
+
 TtfFont *TtfFontList::LoadFont(const std::string &font)
 {
-    LoadAll();
-
     TtfFont *tf = std::find_if(l.begin(), l.end(),
         [&font](const TtfFont &tf) { return tf.FontFileBaseName() == font; });
 
@@ -102,6 +247,8 @@ TtfFont *TtfFontList::LoadFont(const std::string &font)
                 tf->LoadFromFile(fontLibrary, /*keepOpen=*/true);
         }
         return tf;
+    } else if(!loaded) {
+        return OpenFont(font);
     } else {
         return NULL;
     }
@@ -35,11 +35,15 @@ public:
     FT_LibraryRec_ *fontLibrary;
     bool            loaded;
     List<TtfFont>   l;
+    bool            listed;
+    std::vector<Platform::Path> fontFiles;
 
     TtfFontList();
     ~TtfFontList();
 
+    const std::vector<Platform::Path> &FontFiles();
     void LoadAll();
+    TtfFont *OpenFont(const std::string &font);
     TtfFont *LoadFont(const std::string &font);
 
     void PlotString(const std::string &font, const std::string &str,
@@ -443,7 +443,10 @@ public:
     static void ScreenChangeTurntableNav(int link, uint32_t v);
     static void ScreenChangeImmediatelyEditDimension(int link, uint32_t v);
     static void ScreenChangeAutomaticLineConstraints(int link, uint32_t v);
+    static void ScreenChangeCacheLinkedFiles(int link, uint32_t v);
+    static void ScreenChangeCompressSavedFiles(int link, uint32_t v);
     static void ScreenChangePwlCurves(int link, uint32_t v);
+    static void ScreenChangeGltfQuantize(int link, uint32_t v);
     static void ScreenChangeCanvasSizeAuto(int link, uint32_t v);
     static void ScreenChangeCanvasSize(int link, uint32_t v);
     static void ScreenChangeShadedTriangles(int link, uint32_t v);
@@ -31,11 +31,126 @@ void SolveSpaceUI::UndoRedo() {
 }
 
 void SolveSpaceUI::UndoEnableMenus() {
+    if(!SS.GW.window) return;
+
     SS.GW.undoMenuItem->SetEnabled(undo.cnt > 0);
     SS.GW.redoMenuItem->SetEnabled(redo.cnt > 0);
 }
 
+//-----------------------------------------------------------------------------
+// Record the objects in a list, sharing each with the reference state (the
+// one that was recorded last) if it's saved just as it was then; copy() makes
+// a snapshot of any that aren't. Both are sorted by handle, so we can walk
+// them together.
+//-----------------------------------------------------------------------------
+template<class T, class H, class F>
+static void Snapshot(int type, IdList<T,H> *list,
+                     const std::vector<std::shared_ptr<const T>> *ref,
+                     std::vector<std::shared_ptr<const T>> *out, F copy)
+{
+    out->reserve(list->n);
+    size_t j = 0;
+    for(T &obj : *list) {
+        if(ref != NULL) {
+            while(j < ref->size() && (*ref)[j]->h.v < obj.h.v) j++;
+            if(j < ref->size() && (*ref)[j]->h == obj.h &&
+               SolveSpaceUI::SavedFieldsEqual(type, (*ref)[j].get(), &obj)) {
+                out->push_back((*ref)[j]);
+                continue;
+            }
+        }
+        out->push_back(copy(obj));
+    }
+}
+
+template<class T>
+static std::shared_ptr<const T> Copy(const T &src) {
+    // Shallow copy
+    return std::make_shared<const T>(src);
+}
+
+static std::shared_ptr<const Group> CopyGroup(const Group &src) {
+    // Shallow copy
+    std::shared_ptr<Group> dest = std::make_shared<Group>(src);
+    // And then clean up all the stuff that needs to be a deep copy,
+    // and zero out all the dynamic stuff that will get regenerated.
+    dest->clean = false;
+    dest->fingerprint = 0;
+    dest->solved = {};
+    dest->polyLoops = {};
+    dest->bezierLoops = {};
+    dest->bezierOpens = {};
+    dest->polyError = {};
+    dest->thisMesh = {};
+    dest->runningMesh = {};
+    dest->thisShell = {};
+    dest->runningShell = {};
+    dest->displayMesh = {};
+    dest->displayOutlines = {};
+
+    dest->remap = src.remap;
+
+    // The linked file is shared, and never changes once loaded, so we can
+    // keep it; undo only reads it again if it's changed on disk since.
+    return dest;
+}
+
+//-----------------------------------------------------------------------------
+// Call changed() with every object that's only in the sketch, only in the undo
+// state, or in both but saved differently.
+//-----------------------------------------------------------------------------
+template<class T, class H, class F>
+static void ForEachChanged(int type, IdList<T,H> *list,
+                           const std::vector<std::shared_ptr<const T>> &saved, F changed)
+{
+    auto it = list->begin();
+    size_t j = 0;
+    while(it != list->end() || j < saved.size()) {
+        if(j == saved.size() || (it != list->end() && it->h.v < saved[j]->h.v)) {
+            changed(*it);
+            ++it;
+        } else if(it == list->end() || saved[j]->h.v < it->h.v) {
+            changed(*saved[j]);
+            j++;
+        } else {
+            if(!SolveSpaceUI::SavedFieldsEqual(type, &*it, saved[j].get())) {
+                changed(*it);
+            }
+            ++it;
+            j++;
+        }
+    }
+}
+
+// The state that was recorded last on the given stack, or NULL if it's empty.
+static const SolveSpaceUI::UndoState *LastState(const SolveSpaceUI::UndoStack *uk) {
+    if(uk->cnt == 0) return NULL;
+    return &(uk->d[WRAP(uk->write - 1, SolveSpaceUI::MAX_UNDO)]);
+}
+
+void SolveSpaceUI::RecordState(UndoState *ut, const UndoState *ref) {
+    *ut = {};
+    Snapshot('g', &SK.group,      ref ? &ref->group      : NULL, &ut->group,      CopyGroup);
+    for(auto &src : SK.groupOrder) { ut->groupOrder.Add(&src); }
+    Snapshot('r', &SK.request,    ref ? &ref->request    : NULL, &ut->request,    Copy<Request>);
+    Snapshot('c', &SK.constraint, ref ? &ref->constraint : NULL, &ut->constraint, Copy<Constraint>);
+    Snapshot('p', &SK.param,      ref ? &ref->param      : NULL, &ut->param,      Copy<Param>);
+    Snapshot('s', &SK.style,      ref ? &ref->style      : NULL, &ut->style,      Copy<Style>);
+    ut->activeGroup = SS.GW.activeGroup;
+}
+
+void SolveSpaceUI::RecordCurrentState(UndoState *ut) {
+    // Share whatever we can with the state recorded last, on either stack.
+    const UndoState *ref = LastState(&undo);
+    if(ref == NULL) ref = LastState(&redo);
+    RecordState(ut, ref);
+}
+
 void SolveSpaceUI::PushFromCurrentOnto(UndoStack *uk) {
+    // Share whatever we can with the state recorded last, on either stack.
+    const UndoState *ref = LastState(uk);
+    if(ref == NULL) ref = LastState((uk == &undo) ? &redo : &undo);
+
     if(uk->cnt == MAX_UNDO) {
         UndoClearState(&(uk->d[uk->write]));
         // And then write in to this one again
@@ -44,47 +159,12 @@ void SolveSpaceUI::PushFromCurrentOnto(UndoStack *uk) {
     }
 
     UndoState *ut = &(uk->d[uk->write]);
-    *ut = {};
-    ut->group.ReserveMore(SK.group.n);
-    for(Group &src : SK.group) {
-        // Shallow copy
-        Group dest(src);
-        // And then clean up all the stuff that needs to be a deep copy,
-        // and zero out all the dynamic stuff that will get regenerated.
-        dest.clean = false;
-        dest.solved = {};
-        dest.polyLoops = {};
-        dest.bezierLoops = {};
-        dest.bezierOpens = {};
-        dest.polyError = {};
-        dest.thisMesh = {};
-        dest.runningMesh = {};
-        dest.thisShell = {};
-        dest.runningShell = {};
-        dest.displayMesh = {};
-        dest.displayOutlines = {};
-
-        dest.remap = src.remap;
-
-        dest.impMesh = {};
-        dest.impShell = {};
-        dest.impEntity = {};
-        ut->group.Add(&dest);
-    }
-    for(auto &src : SK.groupOrder) { ut->groupOrder.Add(&src); }
-    ut->request.ReserveMore(SK.request.n);
-    for(auto &src : SK.request) { ut->request.Add(&src); }
-    ut->constraint.ReserveMore(SK.constraint.n);
-    for(auto &src : SK.constraint) {
-        // Shallow copy
-        Constraint dest(src);
-        ut->constraint.Add(&dest);
+    RecordState(ut, ref);
+    for(Group &g : SK.group) {
+        if(!g.clean || g.fingerprint == 0) continue;
+        ut->fingerprints.push_back(g.fingerprint);
+        undoFingerprints[g.fingerprint]++;
     }
-    ut->param.ReserveMore(SK.param.n);
-    for(auto &src : SK.param) { ut->param.Add(&src); }
-    ut->style.ReserveMore(SK.style.n);
-    for(auto &src : SK.style) { ut->style.Add(&src); }
-    ut->activeGroup = SS.GW.activeGroup;
 
     uk->write = WRAP(uk->write + 1, MAX_UNDO);
 }
@@ -96,11 +176,48 @@ void SolveSpaceUI::PopOntoCurrentFrom(UndoStack *uk) {
 
     UndoState *ut = &(uk->d[uk->write]);
 
-    // Free everything in the main copy of the program before replacing it
-    for(hGroup hg : SK.groupOrder) {
-        Group *g = SK.GetGroup(hg);
-        g->Clear();
+    // Find the groups that the difference between the sketch and the undo
+    // state touches; anything else that we generated is still good.
+    std::set<uint32_t> dirty;
+    std::vector<hParam> changedParams;
+    ForEachChanged('r', &SK.request, ut->request,
+        [&](const Request &r) { dirty.insert(r.group.v); });
+    ForEachChanged('c', &SK.constraint, ut->constraint,
+        [&](const Constraint &c) { dirty.insert(c.group.v); });
+    ForEachChanged('p', &SK.param, ut->param,
+        [&](const Param &p) { changedParams.push_back(p.h); });
+
+    // Groups that are saved just as in the undo state are kept as they are,
+    // with their meshes and so on; the rest are replaced. Those that go away
+    // make all of the groups after them dirty.
+    IdList<Group,hGroup> group = {};
+    int removedOrder = INT_MAX;
+    for(Group &g : SK.group) { g.tag = 0; }
+    for(const std::shared_ptr<const Group> &src : ut->group) {
+        Group *g = SK.group.FindByIdNoOops(src->h);
+        if(g != NULL && SavedFieldsEqual('g', g, src.get())) {
+            group.Add(g);
+            // Now owned by the copy that we just made; keep the handle,
+            // since the list is sorted by it.
+            *g = {};
+            g->h   = src->h;
+            g->tag = 1;
+        } else {
+            Group dest(*src);
+            group.Add(&dest);
+        }
+    }
+    for(Group &g : SK.group) {
+        if(g.tag) continue;
+        if(ut->group.end() == std::find_if(ut->group.begin(), ut->group.end(),
+                [&](const std::shared_ptr<const Group> &sg) { return sg->h == g.h; })) {
+            removedOrder = min(removedOrder, g.order);
+        }
+        // A redo may bring this back.
+        StashGroupGeometry(&g);
     }
+
+    // Free everything in the main copy of the program before replacing it
     SK.group.Clear();
     SK.groupOrder.Clear();
     SK.request.Clear();
@@ -108,29 +225,83 @@ void SolveSpaceUI::PopOntoCurrentFrom(UndoStack *uk) {
     SK.param.Clear();
     SK.style.Clear();
 
-    // And then do a shallow copy of the state from the undo list
-    ut->group.MoveSelfInto(&(SK.group));
+    // And then copy the state from the undo list
+    group.MoveSelfInto(&(SK.group));
     for(auto &gh : ut->groupOrder) { SK.groupOrder.Add(&gh); }
-    ut->request.MoveSelfInto(&(SK.request));
-    ut->constraint.MoveSelfInto(&(SK.constraint));
-    ut->param.MoveSelfInto(&(SK.param));
-    ut->style.MoveSelfInto(&(SK.style));
+    SK.request.ReserveMore((int)ut->request.size());
+    for(auto &src : ut->request) { Request r(*src); SK.request.Add(&r); }
+    SK.constraint.ReserveMore((int)ut->constraint.size());
+    for(auto &src : ut->constraint) { Constraint c(*src); SK.constraint.Add(&c); }
+    SK.param.ReserveMore((int)ut->param.size());
+    for(auto &src : ut->param) { Param p(*src); SK.param.Add(&p); }
+    SK.style.ReserveMore((int)ut->style.size());
+    for(auto &src : ut->style) { Style s(*src); SK.style.Add(&s); }
     SS.GW.activeGroup = ut->activeGroup;
 
-    // No need to free it, since a shallow copy was made above
-    *ut = {};
+    UndoClearState(ut);
+
+    // A parameter belongs to the group of its request, to its own group,
+    // or to the group of the constraint that it's the value of.
+    for(hParam hp : changedParams) {
+        if((hp.v & 0xc0000000) == 0) {
+            Request *r = SK.request.FindByIdNoOops(hp.request());
+            if(r != NULL) dirty.insert(r->group.v);
+        } else if(hp.v & 0x80000000) {
+            dirty.insert((hp.v & 0x7fffffff) >> 16);
+        } else {
+            for(Constraint &c : SK.constraint) {
+                if(c.valP == hp) dirty.insert(c.group.v);
+            }
+        }
+    }
 
     // And reset the state everywhere else in the program, since the
-    // sketch just changed a lot.
+    // sketch just changed a lot. Linked files that are unchanged on disk
+    // (by size and modification time) are shared rather than read again;
+    // but a group whose file did change must be regenerated.
     SS.GW.ClearSuper();
     SS.TW.ClearSuper();
-    SS.ReloadAllLinked(SS.saveFile);
-    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+    for(Group &g : SK.group) {
+        if(g.type != Group::Type::LINKED) continue;
+        if(SS.ReloadChangedLinked(&g)) dirty.insert(g.h.v);
+    }
+
+    // Everything after a dirty group depends on it, so is dirty too.
+    int dirtyOrder = removedOrder;
+    for(Group &g : SK.group) {
+        if(!g.clean || dirty.count(g.h.v)) dirtyOrder = min(dirtyOrder, g.order);
+    }
+    for(Group &g : SK.group) {
+        if(g.order >= dirtyOrder) g.clean = false;
+    }
+
+    // But if we still have what we generated from exactly this state before,
+    // those groups are good again; until the first that we don't have, since
+    // everything after that will be regenerated anyway.
+    std::map<uint32_t, uint64_t> fingerprints;
+    SS.FingerprintGroups(&fingerprints);
+    for(hGroup hg : SK.groupOrder) {
+        Group *g = SK.GetGroup(hg);
+        if(g->clean) continue;
+        if(g->fingerprint != fingerprints[hg.v] &&
+           !SS.RestoreGroupGeometry(g, fingerprints[hg.v])) break;
+        g->clean = true;
+    }
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
     SS.ScheduleShowTW();
 
-    // Activate the group that was active before.
+    // Activate the group that was active before. That marks it dirty, for
+    // good measure; but what we just generated or restored is good, and
+    // making it again would undo the point of keeping it.
+    std::vector<hGroup> clean;
+    for(Group &g : SK.group) {
+        if(g.clean) clean.push_back(g.h);
+    }
     Group *activeGroup = SK.GetGroup(SS.GW.activeGroup);
     activeGroup->Activate();
+    for(hGroup hg : clean) {
+        SK.GetGroup(hg)->clean = true;
+    }
 }
 
 void SolveSpaceUI::UndoClearStack(UndoStack *uk) {
@@ -143,12 +314,19 @@ void SolveSpaceUI::UndoClearStack(UndoStack *uk) {
 }
 
 void SolveSpaceUI::UndoClearState(UndoState *ut) {
-    for(auto &g : ut->group) { g.remap.clear(); }
-    ut->group.Clear();
-    ut->request.Clear();
-    ut->constraint.Clear();
-    ut->param.Clear();
-    ut->style.Clear();
+    for(uint64_t fingerprint : ut->fingerprints) {
+        auto it = undoFingerprints.find(fingerprint);
+        if(it != undoFingerprints.end() && --(it->second) == 0) {
+            undoFingerprints.erase(it);
+        }
+    }
+    ut->Clear();
     *ut = {};
 }
 
+// Whether the geometry with this fingerprint was generated for a state that
+// an undo or a redo could bring back.
+bool SolveSpaceUI::UndoMayRestore(uint64_t fingerprint) {
+    return undoFingerprints.count(fingerprint) > 0;
+}
+
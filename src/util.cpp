@@ -35,6 +35,66 @@ std::string SolveSpace::ssprintf(const char *fmt, ...)
     return result;
 }
 
+void SolveSpace::AppendFixed(std::string *str, double v, int digits) {
+    ssassert(digits >= 0 && digits <= 20, "Unexpected number of digits");
+#if defined(__SIZEOF_INT128__)
+    typedef unsigned __int128 uint128_t;
+    // Anything we'd write in practice; the rest goes to printf().
+    if(std::isfinite(v) && fabs(v) < 1e15) {
+        // The value is exactly m*2^exp; so the decimal places of it are
+        // m*5^digits*2^(exp+digits), rounded to nearest with ties to even,
+        // just as printf() does. That fits in 128 bits for |v| < 1e15.
+        int exp;
+        double frac = frexp(fabs(v), &exp);
+        uint64_t m = (uint64_t)ldexp(frac, 53);
+        exp -= 53;
+
+        uint64_t pow5 = 1;
+        for(int i = 0; i < digits; i++) pow5 *= 5;
+        uint128_t n = (uint128_t)m * pow5;
+        int shift = -(exp + digits);
+        if(shift <= 0) {
+            n <<= -shift;
+        } else if(shift >= 128) {
+            n = 0;
+        } else {
+            uint128_t q    = n >> shift,
+                      r    = n - (q << shift),
+                      half = (uint128_t)1 << (shift - 1);
+            if(r > half || (r == half && (q & 1))) q++;
+            n = q;
+        }
+
+        const uint64_t POW10_10 = 10000000000ull;
+        uint128_t  pow10 = (uint128_t)pow5 << digits;
+        uint64_t   whole = (uint64_t)(n / pow10);
+        uint128_t  fracPart = n % pow10;
+        uint64_t   fracLo = (uint64_t)(fracPart % POW10_10),
+                   fracHi = (uint64_t)(fracPart / POW10_10);
+
+        char buf[48];
+        char *p = buf + sizeof(buf);
+        for(int i = 0; i < digits && i < 10; i++) {
+            *--p = (char)('0' + fracLo % 10);
+            fracLo /= 10;
+        }
+        for(int i = 10; i < digits; i++) {
+            *--p = (char)('0' + fracHi % 10);
+            fracHi /= 10;
+        }
+        if(digits > 0) *--p = '.';
+        do {
+            *--p = (char)('0' + whole % 10);
+            whole /= 10;
+        } while(whole != 0);
+        if(std::signbit(v)) *--p = '-';
+        str->append(p, buf + sizeof(buf) - p);
+        return;
+    }
+#endif
+    str->append(ssprintf("%.*f", digits, v));
+}
+
 char32_t utf8_iterator::operator*()
 {
     const uint8_t *it = (const uint8_t*) this->p;
@@ -63,6 +123,192 @@ int64_t SolveSpace::GetMilliseconds()
     return std::chrono::duration_cast<std::chrono::milliseconds>(timestamp).count();
 }
 
+int64_t SolveSpace::GetMicroseconds()
+{
+    auto timestamp = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(timestamp).count();
+}
+
+//-----------------------------------------------------------------------------
+// Per-phase profiling of regeneration. The entries are accumulated by group
+// and phase, in the order that each was first seen.
+//-----------------------------------------------------------------------------
+bool   Profile::enabled      = false;
+hGroup Profile::currentGroup = {};
+
+static std::vector<Profile::Entry>                      ProfileEntries;
+static std::map<std::pair<uint32_t, uint32_t>, size_t>  ProfileEntryIndex;
+static std::map<uint32_t, std::string>                  ProfileGroupNames;
+
+void Profile::NameGroup(hGroup hg, const std::string &name) {
+    ProfileGroupNames[hg.v] = name;
+}
+
+void Profile::Add(hGroup hg, Phase phase, int64_t micros,
+                  uint64_t allocations, uint64_t allocatedBytes) {
+    auto key = std::make_pair(hg.v, (uint32_t)phase);
+    auto it = ProfileEntryIndex.find(key);
+    if(it == ProfileEntryIndex.end()) {
+        Entry e = {};
+        e.group = hg;
+        e.phase = phase;
+        it = ProfileEntryIndex.emplace(key, ProfileEntries.size()).first;
+        ProfileEntries.push_back(e);
+    }
+
+    Entry *e = &ProfileEntries[it->second];
+    e->count++;
+    e->micros         += micros;
+    e->allocations    += allocations;
+    e->allocatedBytes += allocatedBytes;
+}
+
+std::vector<Profile::Entry> Profile::GetEntries() {
+    return ProfileEntries;
+}
+
+void Profile::Clear() {
+    currentGroup = {};
+    ProfileEntries.clear();
+    ProfileEntryIndex.clear();
+    ProfileGroupNames.clear();
+    Platform::ResetTemporaryStats();
+}
+
+const char *Profile::PhaseName(Phase phase) {
+    switch(phase) {
+        case Phase::GENERATE_ALL:   return "generate-all";
+        case Phase::ENTITIES:       return "entities";
+        case Phase::EQUATIONS:      return "equations";
+        case Phase::JACOBIAN:       return "jacobian";
+        case Phase::NEWTON:         return "newton";
+        case Phase::RANK_TEST:      return "rank-test";
+        case Phase::SOLVE:          return "solve";
+        case Phase::SHELL_AND_MESH: return "shell-and-mesh";
+        case Phase::BOOLEAN:        return "boolean";
+        case Phase::TRIANGULATE:    return "triangulate";
+        case Phase::DISPLAY_ITEMS:  return "display-items";
+        case Phase::INIT:           return "init";
+        case Phase::RESOURCES:      return "resources";
+        case Phase::FONTS:          return "fonts";
+        case Phase::LOAD_FILE:      return "load-file";
+    }
+    ssassert(false, "Unexpected profile phase");
+}
+
+void SolveSpace::ParallelFor(size_t count, const std::function<void(size_t)> &fn) {
+    size_t workers = std::min((size_t)std::max(1u, std::thread::hardware_concurrency()),
+                              count);
+    if(workers <= 1) {
+        for(size_t i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    // Each worker, including this thread, takes the next index until none
+    // are left; so a few slow calls don't hold up the rest.
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for(size_t i; (i = next.fetch_add(1)) < count;) fn(i);
+    };
+    std::vector<std::thread> threads;
+    for(size_t i = 1; i < workers; i++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for(std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+std::string SolveSpace::JsonString(const std::string &str) {
+    std::string result = "\"";
+    for(char c : str) {
+        switch(c) {
+            case '"':  result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n";  break;
+            case '\t': result += "\\t";  break;
+            default:
+                if((unsigned char)c < 0x20) {
+                    result += ssprintf("\\u%04x", c);
+                } else {
+                    result += c;
+                }
+        }
+    }
+    result += "\"";
+    return result;
+}
+
+std::string Profile::ToJson(const std::string &source) {
+    // Group the entries by group, keeping the order in which the groups
+    // were first seen.
+    std::vector<uint32_t> groups;
+    for(const Entry &e : ProfileEntries) {
+        if(std::find(groups.begin(), groups.end(), e.group.v) == groups.end()) {
+            groups.push_back(e.group.v);
+        }
+    }
+
+    std::string json = "{\"source\":" + JsonString(source) + ",\"groups\":[";
+    for(size_t i = 0; i < groups.size(); i++) {
+        if(i > 0) json += ",";
+        json += "{\"group\":";
+        json += JsonString(groups[i] == 0 ? "" : ssprintf("g%03x", groups[i]));
+        auto name = ProfileGroupNames.find(groups[i]);
+        if(name != ProfileGroupNames.end()) {
+            json += ",\"name\":" + JsonString(name->second);
+        }
+        json += ",\"phases\":{";
+        bool first = true;
+        for(const Entry &e : ProfileEntries) {
+            if(e.group.v != groups[i]) continue;
+            if(!first) json += ",";
+            first = false;
+            json += ssprintf("\"%s\":{\"count\":%llu,\"ms\":%.3f,"
+                             "\"allocations\":%llu,\"bytes\":%llu}",
+                             PhaseName(e.phase), (unsigned long long)e.count,
+                             e.micros / 1000.0,
+                             (unsigned long long)e.allocations,
+                             (unsigned long long)e.allocatedBytes);
+        }
+        json += "}}";
+    }
+    json += "]";
+
+    // And the arenas of the temporary scopes, which aren't specific to any
+    // one group.
+    json += ",\"temporary\":[";
+    std::vector<Platform::TemporaryStats> stats = Platform::GetTemporaryStats();
+    for(size_t i = 0; i < stats.size(); i++) {
+        if(i > 0) json += ",";
+        json += ssprintf("{\"name\":%s,\"count\":%llu,\"allocations\":%llu,"
+                         "\"bytes\":%llu,\"peak_bytes\":%llu}",
+                         JsonString(stats[i].name).c_str(),
+                         (unsigned long long)stats[i].count,
+                         (unsigned long long)stats[i].allocations,
+                         (unsigned long long)stats[i].totalBytes,
+                         (unsigned long long)stats[i].peakBytes);
+    }
+    json += "]}";
+    return json;
+}
+
+ProfileScope::ProfileScope(hGroup hg, Profile::Phase phase) :
+        group(hg), phase(phase), active(Profile::enabled) {
+    if(!active) return;
+    startMicros = GetMicroseconds();
+    Platform::GetTemporaryCounters(&startAllocations, &startAllocatedBytes);
+}
+
+ProfileScope::~ProfileScope() {
+    if(!active) return;
+    uint64_t allocations, allocatedBytes;
+    Platform::GetTemporaryCounters(&allocations, &allocatedBytes);
+    Profile::Add(group, phase, GetMicroseconds() - startMicros,
+                 allocations - startAllocations, allocatedBytes - startAllocatedBytes);
+}
+
 void SolveSpace::MakeMatrix(double *mat,
                             double a11, double a12, double a13, double a14,
                             double a21, double a22, double a23, double a24,
@@ -178,13 +424,19 @@ static void MessageBox(const char *fmt, va_list va, bool error,
     dialog->ShowModal();
 #endif
 }
+static unsigned ErrorsReported;
+
 void SolveSpace::Error(const char *fmt, ...)
 {
+    ErrorsReported++;
     va_list f;
     va_start(f, fmt);
     MessageBox(fmt, f, /*error=*/true);
     va_end(f);
 }
+unsigned SolveSpace::ErrorCount() {
+    return ErrorsReported;
+}
 void SolveSpace::Message(const char *fmt, ...)
 {
     va_list f;
@@ -15,3 +15,15 @@ TEST_CASE(normal_migrate_from_v22) {
     CHECK_LOAD("normal_v22.slvs");
     CHECK_SAVE("normal.slvs");
 }
+
+TEST_CASE(normal_export_mesh_then_save) {
+    CHECK_LOAD("normal.slvs");
+    Platform::Path stlPath = helper->GetAssetPath(__FILE__, "normal.stl", "out");
+    SS.ExportMeshTo(stlPath);
+    std::string stlData;
+    CHECK_TRUE(ReadFile(stlPath, &stlData));
+    CHECK_TRUE(stlData.size() > 84);
+    RemoveFile(stlPath);
+    CHECK_FALSE(SK.GetGroup(SS.GW.activeGroup)->runningShell.IsEmpty());
+    CHECK_SAVE("normal.slvs");
+}
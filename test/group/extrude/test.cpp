@@ -0,0 +1,292 @@
+#include "harness.h"
+
+// The volume of the active group's mesh; here, a circle of radius 5 mm in the
+// sketch, with a diameter constraint, extruded by 10 mm.
+static double MeshVolume() {
+    Group *g = SK.GetGroup(SS.GW.activeGroup);
+    g->GenerateDisplayItems();
+    return g->displayMesh.CalculateVolume();
+}
+
+static double CylinderVolume(double diameter) {
+    return PI * diameter * diameter / 4 * 10;
+}
+
+TEST_CASE(normal_roundtrip) {
+    CHECK_LOAD("normal.slvs");
+    CHECK_SAVE("normal.slvs");
+}
+
+TEST_CASE(normal_roundtrip_compressed) {
+    CHECK_LOAD("normal.slvs");
+    Platform::Path gzPath = helper->GetAssetPath(__FILE__, "normal_gz.slvs", "out");
+    SS.compressSavedFiles = true;
+    CHECK_TRUE(SS.SaveToFile(gzPath));
+    SS.compressSavedFiles = false;
+    std::string gzData;
+    CHECK_TRUE(ReadFile(gzPath, &gzData));
+    CHECK_TRUE(gzData.size() > 2 && (uint8_t)gzData[0] == 0x1f && (uint8_t)gzData[1] == 0x8b);
+
+    // Read back, it saves just as the plain file did.
+    CHECK_TRUE(SS.LoadFromFile(gzPath));
+    SS.AfterNewFile();
+    RemoveFile(gzPath);
+    CHECK_SAVE("normal.slvs");
+}
+
+TEST_CASE(normal_set_dimension_after_export) {
+    CHECK_LOAD("normal.slvs");
+    SS.exportChordTol = 0.01;
+    SS.GenerateForExport();
+    CHECK_TRUE(fabs(MeshVolume() / CylinderVolume(10) - 1) < 0.01);
+
+    // Still in export mode, as the command line stays from one request to
+    // the next; the changed group must be solved all the same.
+    Constraint *c = SK.GetConstraint(hConstraint{3});
+    c->valA = 20;
+    SS.MarkGroupDirty(c->group);
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    CHECK_TRUE(SS.exportMode);
+    CHECK_TRUE(fabs(MeshVolume() / CylinderVolume(20) - 1) < 0.01);
+
+    c->valA = 30;
+    SS.MarkGroupDirty(c->group);
+    SS.GenerateForExport();
+    CHECK_TRUE(fabs(MeshVolume() / CylinderVolume(30) - 1) < 0.01);
+}
+
+TEST_CASE(normal_export_variants) {
+    // One variant after another, as set-dimension --variants writes them.
+    CHECK_LOAD("normal.slvs");
+    SS.exportChordTol = 0.01;
+    Constraint *c = SK.GetConstraint(hConstraint{3});
+    Platform::Path stlPath = helper->GetAssetPath(__FILE__, "normal.stl", "out");
+    std::string stlData[2];
+    for(int i = 0; i < 2; i++) {
+        c->valA = 10.0 * (i + 1);
+        SS.MarkGroupDirty(c->group);
+        SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+        SS.ExportMeshTo(stlPath);
+        CHECK_TRUE(ReadFile(stlPath, &stlData[i]));
+        RemoveFile(stlPath);
+        CHECK_TRUE(fabs(MeshVolume() / CylinderVolume(c->valA) - 1) < 0.01);
+    }
+    CHECK_TRUE(stlData[0] != stlData[1]);
+}
+
+// The triangles of the extrusion's mesh, to compare a regenerated sketch with
+// the one it was regenerated from.
+static std::vector<STriangle> ExtrudeMesh() {
+    Group *g = SK.group.FindByIdNoOops(hGroup{3});
+    if(g == NULL) return {};
+    g->GenerateDisplayItems();
+    return std::vector<STriangle>(g->displayMesh.l.begin(), g->displayMesh.l.end());
+}
+
+static bool MeshesEqual(const std::vector<STriangle> &a,
+                        const std::vector<STriangle> &b) {
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); i++) {
+        if(!a[i].a.Equals(b[i].a) || !a[i].b.Equals(b[i].b) ||
+           !a[i].c.Equals(b[i].c)) return false;
+    }
+    return true;
+}
+
+TEST_CASE(normal_undo_param) {
+    CHECK_LOAD("normal.slvs");
+    std::vector<STriangle> before = ExtrudeMesh();
+    CHECK_TRUE(!before.empty());
+
+    // The extrusion's depth, as if dragged.
+    SS.UndoRemember();
+    SK.GetParam(hGroup{3}.param(2))->val = -8;
+    SS.MarkGroupDirty(hGroup{3});
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    std::vector<STriangle> after = ExtrudeMesh();
+    CHECK_TRUE(!MeshesEqual(before, after));
+
+    SS.UndoUndo();
+    CHECK_EQ_EPS(SK.GetParam(hGroup{3}.param(2))->val, -5);
+    CHECK_TRUE(MeshesEqual(ExtrudeMesh(), before));
+    SS.UndoRedo();
+    CHECK_TRUE(MeshesEqual(ExtrudeMesh(), after));
+}
+
+TEST_CASE(normal_undo_constraint) {
+    CHECK_LOAD("normal.slvs");
+    std::vector<STriangle> before = ExtrudeMesh();
+
+    SS.UndoRemember();
+    Constraint *c = SK.GetConstraint(hConstraint{3});
+    c->valA = 20;
+    SS.MarkGroupDirty(c->group);
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    std::vector<STriangle> after = ExtrudeMesh();
+    CHECK_TRUE(!MeshesEqual(before, after));
+
+    SS.UndoUndo();
+    CHECK_EQ_EPS(SK.GetConstraint(hConstraint{3})->valA, 10);
+    CHECK_TRUE(MeshesEqual(ExtrudeMesh(), before));
+    SS.UndoRedo();
+    CHECK_TRUE(MeshesEqual(ExtrudeMesh(), after));
+    CHECK_TRUE(fabs(MeshVolume() / CylinderVolume(20) - 1) < 0.02);
+}
+
+TEST_CASE(normal_undo_delete_group) {
+    CHECK_LOAD("normal.slvs");
+    std::vector<STriangle> before = ExtrudeMesh();
+
+    // As TextWindow::ScreenDeleteGroup does it.
+    SS.UndoRemember();
+    SS.GW.activeGroup = SK.GetGroup(hGroup{3})->PreviousGroup()->h;
+    SK.group.RemoveById(hGroup{3});
+    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+    CHECK_TRUE(ExtrudeMesh().empty());
+
+    SS.UndoUndo();
+    CHECK_TRUE(SS.GW.activeGroup == hGroup{3});
+    CHECK_TRUE(MeshesEqual(ExtrudeMesh(), before));
+    CHECK_SAVE("normal.slvs");
+    SS.UndoRedo();
+    CHECK_TRUE(ExtrudeMesh().empty());
+}
+
+TEST_CASE(normal_fingerprint_follows_export_tolerance) {
+    // What's meshed for export mustn't be taken for what's meshed for display.
+    CHECK_LOAD("normal.slvs");
+    std::map<uint32_t, uint64_t> display, exported;
+    SS.FingerprintGroups(&display);
+    SS.exportMode = true;
+    SS.FingerprintGroups(&exported);
+    SS.exportMode = false;
+    CHECK_TRUE(display[3] != exported[3]);
+}
+
+TEST_CASE(normal_undo_drag) {
+    CHECK_LOAD("normal.slvs");
+    // Activating the group on load marked it dirty; regenerate, as the
+    // graphics window would before anything could be dragged.
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    std::vector<STriangle> before = ExtrudeMesh();
+
+    // A drag remembers the sketch once, and then regenerates at every step;
+    // only what we had before the first step is worth keeping. (Not so far
+    // that the model's size, and so the chord tolerance, changes.)
+    SS.UndoRemember();
+    for(int i = 1; i <= 20; i++) {
+        SK.GetParam(hGroup{3}.param(2))->val = -5 - 0.01 * i;
+        SS.MarkGroupDirty(hGroup{3});
+        SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    }
+    CHECK_TRUE(SS.StashedGroupGeometryCount() == 1);
+
+    // And the undo takes it back, rather than solving and meshing again.
+    SS.UndoUndo();
+    CHECK_TRUE(SS.StashedGroupGeometryCount() == 0);
+    CHECK_TRUE(SK.GetGroup(hGroup{3})->clean);
+    CHECK_TRUE(MeshesEqual(ExtrudeMesh(), before));
+}
+
+// The mesh exported as binary glTF, and the parts of that we check: the JSON
+// chunk, and the binary chunk, each of which must be aligned to four bytes.
+struct Glb {
+    uint32_t    header[3];
+    std::string json;
+    std::string bin;
+};
+
+static bool ExportGlb(const Platform::Path &glbPath, Glb *glb) {
+    SS.ExportMeshTo(glbPath);
+    std::string data;
+    bool ok = ReadFile(glbPath, &data);
+    RemoveFile(glbPath);
+    if(!ok || data.size() < 20) return false;
+
+    uint32_t chunk[2];
+    memcpy(glb->header, &data[0], sizeof(glb->header));
+    memcpy(chunk, &data[12], sizeof(chunk));
+    if(chunk[1] != 0x4E4F534A || chunk[0] % 4 != 0 || 20 + chunk[0] + 8 > data.size()) {
+        return false;
+    }
+    glb->json = data.substr(20, chunk[0]);
+    size_t binStart = 20 + chunk[0];
+    memcpy(chunk, &data[binStart], sizeof(chunk));
+    if(chunk[1] != 0x004E4942 || chunk[0] % 4 != 0 || binStart + 8 + chunk[0] != data.size()) {
+        return false;
+    }
+    glb->bin = data.substr(binStart + 8, chunk[0]);
+    return glb->header[2] == data.size();
+}
+
+// The three numbers in the array after key, as in "max":[1,2,3].
+static bool JsonVec3(const std::string &json, const char *key, double v[3]) {
+    size_t pos = json.find(key);
+    if(pos == std::string::npos) return false;
+    return sscanf(json.c_str() + pos + strlen(key), "[%lf,%lf,%lf]",
+                  &v[0], &v[1], &v[2]) == 3;
+}
+
+// How many positions there are, from the first accessor.
+static size_t PositionCount(const std::string &json) {
+    size_t pos = json.find("\"accessors\":[{\"bufferView\":0,");
+    if(pos == std::string::npos) return 0;
+    pos = json.find("\"count\":", pos);
+    if(pos == std::string::npos) return 0;
+    return (size_t)atol(json.c_str() + pos + strlen("\"count\":"));
+}
+
+TEST_CASE(normal_export_gltf) {
+    CHECK_LOAD("normal.slvs");
+    Platform::Path glbPath = helper->GetAssetPath(__FILE__, "normal.glb", "out");
+    SS.exportGltfQuantize = false;
+    Glb glb;
+    CHECK_TRUE(ExportGlb(glbPath, &glb));
+    CHECK_TRUE(glb.header[0] == 0x46546C67 && glb.header[1] == 2);
+    CHECK_TRUE(glb.json.find("KHR_mesh_quantization") == std::string::npos);
+
+    // The bounds of the positions are exactly those of the floats stored.
+    size_t count = PositionCount(glb.json);
+    CHECK_TRUE(count > 0 && count * 12 <= glb.bin.size());
+    float fmin[3], fmax[3];
+    for(size_t i = 0; i < count; i++) {
+        float p[3];
+        memcpy(p, &glb.bin[i * 12], sizeof(p));
+        for(int j = 0; j < 3; j++) {
+            fmin[j] = (i == 0) ? p[j] : std::min(fmin[j], p[j]);
+            fmax[j] = (i == 0) ? p[j] : std::max(fmax[j], p[j]);
+        }
+    }
+    double jmin[3], jmax[3];
+    CHECK_TRUE(JsonVec3(glb.json, "\"min\":", jmin));
+    CHECK_TRUE(JsonVec3(glb.json, "\"max\":", jmax));
+    for(int j = 0; j < 3; j++) {
+        CHECK_TRUE((float)jmin[j] == fmin[j] && (float)jmax[j] == fmax[j]);
+    }
+
+    // Quantized, the positions are 16 bit integers that the node's transform
+    // takes back to about where they were.
+    SS.exportGltfQuantize = true;
+    Glb quant;
+    CHECK_TRUE(ExportGlb(glbPath, &quant));
+    SS.exportGltfQuantize = false;
+    CHECK_TRUE(quant.json.find("\"extensionsRequired\":[\"KHR_mesh_quantization\"]") !=
+               std::string::npos);
+    CHECK_TRUE(PositionCount(quant.json) == count && count * 8 <= quant.bin.size());
+    uint16_t qmax[3] = {};
+    for(size_t i = 0; i < count; i++) {
+        uint16_t q[4];
+        memcpy(q, &quant.bin[i * 8], sizeof(q));
+        for(int j = 0; j < 3; j++) qmax[j] = std::max(qmax[j], q[j]);
+    }
+    double qjmin[3], qjmax[3], translation[3], scale[3];
+    CHECK_TRUE(JsonVec3(quant.json, "\"min\":", qjmin));
+    CHECK_TRUE(JsonVec3(quant.json, "\"max\":", qjmax));
+    CHECK_TRUE(JsonVec3(quant.json, "\"translation\":", translation));
+    CHECK_TRUE(JsonVec3(quant.json, "\"scale\":", scale));
+    for(int j = 0; j < 3; j++) {
+        CHECK_TRUE(qjmin[j] == 0 && qjmax[j] == qmax[j]);
+        CHECK_TRUE(fabs(translation[j] - fmin[j]) < 1e-4);
+        CHECK_TRUE(fabs(translation[j] + qmax[j] * scale[j] - fmax[j]) <= scale[j]);
+    }
+}
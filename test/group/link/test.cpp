@@ -15,3 +15,67 @@ TEST_CASE(normal_migrate_from_v22) {
     CHECK_LOAD("normal_v22.slvs");
     CHECK_SAVE("normal.slvs");
 }
+
+TEST_CASE(normal_undo_redo) {
+    CHECK_LOAD("normal.slvs");
+    Group *g = SK.GetGroup(SS.GW.activeGroup);
+    std::shared_ptr<LinkedSketch> linked = g->impLinked;
+    CHECK_TRUE(linked != nullptr);
+
+    SS.UndoRemember();
+    g->valA = 2.0;
+    SS.MarkGroupDirty(g->h);
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    SS.UndoUndo();
+    // The linked file hasn't changed, so it's not read again.
+    CHECK_TRUE(SK.GetGroup(SS.GW.activeGroup)->impLinked == linked);
+    CHECK_SAVE("normal.slvs");
+
+    SS.UndoRedo();
+    CHECK_TRUE(SK.GetGroup(SS.GW.activeGroup)->impLinked == linked);
+}
+
+TEST_CASE(normal_undo_rereads_changed_link) {
+    CHECK_LOAD("normal.slvs");
+    Group *g = SK.GetGroup(SS.GW.activeGroup);
+    // As if the linked file had been changed on disk since it was read.
+    std::shared_ptr<LinkedSketch> stale = std::make_shared<LinkedSketch>();
+    stale->filename = g->linkFile;
+    g->impLinked = stale;
+
+    SS.UndoRemember();
+    g->valA = 2.0;
+    SS.MarkGroupDirty(g->h);
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    SS.UndoUndo();
+    g = SK.GetGroup(SS.GW.activeGroup);
+    CHECK_TRUE(g->impLinked != nullptr && g->impLinked != stale);
+    CHECK_SAVE("normal.slvs");
+}
+
+TEST_CASE(normal_reload_shares_unchanged) {
+    CHECK_LOAD("normal.slvs");
+    Group *g = SK.GetGroup(SS.GW.activeGroup);
+    std::shared_ptr<LinkedSketch> linked = g->impLinked;
+    CHECK_TRUE(linked != nullptr);
+
+    // Nothing else holds the sketch, but it's still shared, not read again.
+    CHECK_TRUE(SS.ReloadAllLinked(SS.saveFile));
+    CHECK_TRUE(SK.GetGroup(SS.GW.activeGroup)->impLinked == linked);
+}
+
+TEST_CASE(normal_cached) {
+    SS.cacheLinkedFiles = true;
+    CHECK_LOAD("normal.slvs");
+    Platform::Path cacheFile =
+        Platform::Path::From(SK.GetGroup(SS.GW.activeGroup)->linkFile.raw + ".cache");
+    // Written whole, through a temporary file.
+    CHECK_TRUE(Platform::FileExists(cacheFile));
+    CHECK_TRUE(!Platform::FileExists(Platform::Path::From(cacheFile.raw + ".tmp")));
+
+    // And then read back in place of the linked file.
+    CHECK_LOAD("normal.slvs");
+    CHECK_SAVE("normal.slvs");
+    SS.cacheLinkedFiles = false;
+    RemoveFile(cacheFile);
+}